@@ -1,111 +1,364 @@
 #include "animation.h"
 #include "part.h"
+#include "interpolate.h"
+#include "framecache.h"
 
 #include <cstdio>
 #include <math.h>
 
+#define DEFAULT_BAKE_LIMIT (1<<20)	// Default bake table memory ceiling
+
 Frame Animation::nullFrame;
 Frame Animation::nullFrameHidden;
 
-Animation::Animation() : m_loop(1), m_frameCount(1), m_rate(15.0) {
+// Revisions are unique across all animations, so a cursor can not mistake a new
+// animation allocated at a deleted one's address for the old one
+static int s_revision = 0;
+int Animation::nextRevision() { return ++s_revision; }
+
+Animation::Animation() : m_loop(1), m_frameCount(1), m_rate(15.0), m_revision(nextRevision()), m_imageRevision(m_revision),
+	m_bakeSlots(0), m_bakeLimit(DEFAULT_BAKE_LIMIT), m_bakeHits(0), m_bakeMisses(0) {
 	memset(&nullFrame, 0, sizeof(Frame));
 	memset(&nullFrameHidden, 0, sizeof(Frame));
 	nullFrame.visible = true;
 }
+Animation::Animation(const Animation& other) : m_id(other.m_id), m_name(other.m_name),
+	m_loop(other.m_loop), m_frameCount(other.m_frameCount), m_rate(other.m_rate), m_revision(nextRevision()), m_imageRevision(m_revision),
+	m_bakeSlots(0), m_bakeLimit(other.m_bakeLimit), m_bakeHits(0), m_bakeMisses(0),
+	m_frames(other.m_frames), m_ikStates(other.m_ikStates) {
+	//Keyframe tracks are shared until modified. The bake table starts empty, and frame images are not shared
+	for(int m=0; m<3; m++) m_keyCount[m] = other.m_keyCount[m];
+}
 Animation::~Animation() {
+	FrameCache::instance().remove(this);
 }
 
 QList<int> Animation::parts() const {
 	QList<int> list;
-	for(PartMap::const_iterator i=m_frames.begin(); i!=m_frames.end(); i++) {
-		list.push_back(i.key());
+	for(int i=0; i<m_frames.size(); i++) {
+		if(m_frames[i].part>=0) list.push_back(m_frames[i].part);
 	}
 	return list;
 }
 
-Animation::PartAnim& Animation::partList(Part* part) {
-	int id = part->getID();
-	//Get part animation data
-	return m_frames[id];
+// Deviation of an interpolated value from a key value, for each channel type
+static float angleError(const float& a, const float& b, float t, const float& value) {
+	float s = a;
+	if(fabs(s-b)>180) s += (s<b? 360: -360);
+	float d = fmod(fabs(s + (b-s) * t - value), 360.f);
+	return d>180? 360-d: d;
+}
+static float offsetError(const QPointF& a, const QPointF& b, float t, const QPointF& value) {
+	QPointF d = a + (b-a) * t - value;
+	return sqrt(d.x()*d.x() + d.y()*d.y());
+}
+static float visibleError(const bool& a, const bool&, float, const bool& value) {
+	return a==value? 0: 1; // Visibility holds the previous key
+}
+
+// Mark keys between the first and last keys of a track that can be removed
+template<typename T> static void reduceTrack(const Track<T>& track, float (*error)(const T&, const T&, float, const T&), float tolerance, int mode, QMap<int,int>& out) {
+	const int* f = track.frames.constData();
+	const QVector<T>& v = track.values;
+	int kept = 0;
+	for(int i=1; i<track.size()-1; i++) {
+		//Can every key since the last kept one be reproduced without key i?
+		bool redundant = true;
+		for(int j=kept+1; j<=i && redundant; j++) {
+			float t = (float)(f[j]-f[kept]) / (f[i+1]-f[kept]);
+			redundant = error(v[kept], v[i+1], t, v[j]) <= tolerance;
+		}
+		if(redundant) out[ f[i] ] |= mode;
+		else kept = i;
+	}
+}
+
+QList<Frame> Animation::redundantKeys(Part* part, float angleTolerance, float offsetTolerance) const {
+	QList<Frame> list;
+	const PartAnim* p = findPart(part);
+	if(!p) return list;
+	QMap<int,int> keys;
+	reduceTrack(p->angle,   angleError,   angleTolerance,  ANGLE, keys);
+	reduceTrack(p->offset,  offsetError,  offsetTolerance, POS,   keys);
+	reduceTrack(p->visible, visibleError, 0,               VIS,   keys);
+	for(QMap<int,int>::const_iterator i=keys.begin(); i!=keys.end(); i++) {
+		Frame key = nullFrame;
+		key.frame = i.key();
+		key.mode = i.value();
+		list.push_back(key);
+	}
+	return list;
+}
+
+Animation::PartAnim* Animation::partList(Part* part) {
+	int slot = part->slot();
+	if(slot<0) return 0; // Part is not in the project
+	if(slot>=m_frames.size()) m_frames.resize(slot+1);
+	PartAnim& anim = m_frames[slot];
+	anim.part = part->getID();
+	return &anim;
+}
+
+const Animation::PartAnim* Animation::findPart(Part* part) const {
+	int slot = part->slot();
+	if(slot<0 || slot>=m_frames.size() || m_frames[slot].part<0) return 0;
+	return &m_frames[slot];
 }
 
 void Animation::setControllerState(int id, bool active) {
+	if(getControllerState(id) != active) invalidate();
 	m_ikStates[id] = active;
 }
 bool Animation::getControllerState(int id) const {
 	return m_ikStates.value(id, true); // default on if undefined
 }
 
+int Animation::keyMode(const PartAnim& anim, int frame) const {
+	int mode = 0;
+	if(anim.angle.isKey(frame))   mode |= ANGLE;
+	if(anim.offset.isKey(frame))  mode |= POS;
+	if(anim.visible.isKey(frame)) mode |= VIS;
+	return mode;
+}
+
+// Get the range of frames whose value depends on a key at frame
+template<typename T> static void affectedFrames(const Track<T>& track, int frame, bool loop, int count, int& first, int& last) {
+	int next = track.find(frame+1);
+	int prev = track.find(frame)-1;
+	int a = prev>=0? track.frames[prev]+1: 0;
+	int b = next<track.size()? track.frames[next]-1: count-1;
+	//Changing the first or last key of a loop also changes the wrapped segment
+	if(loop && (prev<0 || next>=track.size())) a=0, b=count-1;
+	if(a<first) first = a;
+	if(b>last) last = b;
+}
+
 int Animation::setKeyframe(int frame, Part* part, Frame& data) {
-	//Insert frame into list
+	//Set or clear the key in each channel
 	data.frame = frame;
-	PartAnim& list = partList(part);
-	for(PartAnim::Iterator i=list.begin(); i!=list.end(); i++) {
-		if(i->frame == frame) { *i = data; return list.size(); }
-		else if(i->frame > frame) { list.insert(i, data); return list.size(); }
-	}
-	list.push_back(data);
-	return list.size();
+	PartAnim* list = partList(part);
+	if(!list) return 0;
+	PartAnim& anim = *list;
+	bool changed[3] = { true, true, true };
+	if(data.mode & ANGLE) { if(anim.angle.set(frame, data.angle))     countKey(0, frame, 1); }
+	else if(anim.angle.remove(frame))   countKey(0, frame, -1);
+	else changed[0] = false;
+	if(data.mode & POS)   { if(anim.offset.set(frame, data.offset))   countKey(1, frame, 1); }
+	else if(anim.offset.remove(frame))  countKey(1, frame, -1);
+	else changed[1] = false;
+	if(data.mode & VIS)   { if(anim.visible.set(frame, data.visible)) countKey(2, frame, 1); }
+	else if(anim.visible.remove(frame)) countKey(2, frame, -1);
+	else changed[2] = false;
+
+	//Invalidate baked frames and cached images that interpolate from this key
+	int first = m_frameCount, last = -1;
+	if(changed[0]) affectedFrames(anim.angle,   frame, m_loop, m_frameCount, first, last);
+	if(changed[1]) affectedFrames(anim.offset,  frame, m_loop, m_frameCount, first, last);
+	if(changed[2]) affectedFrames(anim.visible, frame, m_loop, m_frameCount, first, last);
+	invalidateBake(part->slot(), first, last);
+	invalidateFrames(first, last);
+	return data.mode;
+}
+
+void Animation::countKey(int channel, int frame, int delta) {
+	if(frame<0) return;
+	QVector<int>& count = m_keyCount[channel];
+	if(frame >= count.size()) count.resize(frame+1);
+	count[frame] += delta;
 }
 
 int Animation::isKeyframe(int frame) {
 	int key = 0;
-	for(PartMap::const_iterator p=m_frames.begin(); p!=m_frames.end(); p++) {
-		for(PartAnim::const_iterator i = p->begin(); i!=p->end(); i++) {
-			if(i->frame==frame) key |= i->mode;
-			if(i->frame>=frame) break;
-		}
+	for(int m=0; m<3; m++) {
+		if(frame>=0 && frame<m_keyCount[m].size() && m_keyCount[m][frame]) key |= 1<<m;
 	}
 	return key;
 }
 int Animation::isKeyframe(int frame, Part* part) {
-	PartAnim& list = partList(part);
-	for(PartAnim::Iterator i=list.begin(); i!=list.end(); i++) {
-		if(i->frame==frame) return i->mode;
-	}
-	return 0;
+	const PartAnim* anim = findPart(part);
+	return anim? keyMode(*anim, frame): 0;
 }
 
 Frame Animation::frameData(int frame, Part* part) {
-	PartAnim& list = partList(part);
-	if(list.empty()) return part->hidden()? nullFrameHidden: nullFrame;
+	const PartAnim* anim = findPart(part);
+	if(!anim || anim->empty()) return part->hidden()? nullFrameHidden: nullFrame;
 
 	//Output frame
 	Frame out;
 	out.frame = frame;
-	out.mode = 0;
+	out.mode = keyMode(*anim, frame);
+	signed char visible;
+	evaluateBaked(part->slot(), frame, 0, out.angle, out.offset, visible);
+	out.visible = visible<0? !part->hidden(): visible;
+	return out;
+}
+
+void Animation::evaluatePose(int frame, PoseBuffer& pose) const {
+	evaluateBatch(frame, pose);
+}
 
-	//Get keyframes for each part
-	const Frame* a[3] = {0,0,0};
-	const Frame* b[3] = {0,0,0};
-	for(PartAnim::iterator i=list.begin(); i!=list.end(); i++) {
-		for(int m=0; m<3; m++) {
-			if(i->mode & (1<<m)) {
-				if(m_loop && !b[m]) b[m] = &(*i); //first key for looping
-				if(i->frame<=frame) a[m] = &(*i); //previous key
-				if(i->frame>=frame && (!b[m]||b[m]->frame<frame)) b[m] = &(*i); //next key
-				if(m_loop && (!a[m] || a[m]->frame>frame))        a[m] = &(*i); //Last key for looping
-			}
+void Animation::evaluatePose(int frame, PoseBuffer& pose, PoseCursor& cursor) {
+	//Rebuild cursor if keys have changed, otherwise step forward from the last frame
+	bool rebuild = cursor.animation!=this || cursor.revision!=m_revision || cursor.keys.size()!=m_frames.size()*3;
+	bool forward = !rebuild && frame >= cursor.frame;
+	if(rebuild) cursor.keys.resize( m_frames.size()*3 );
+	cursor.animation = this;
+	cursor.revision = m_revision;
+	cursor.frame = frame;
+
+	pose.angle.fill(0);
+	pose.offset.fill(QPointF());
+	pose.visible.fill(-1);
+	int* keys = cursor.keys.data();
+	const PartAnim* p = m_frames.constData();
+	for(int s=0; s<m_frames.size(); s++, p++, keys+=3) {
+		if(forward) {
+			keys[0] = p->angle.advance(keys[0], frame);
+			keys[1] = p->offset.advance(keys[1], frame);
+			keys[2] = p->visible.advance(keys[2], frame);
+		} else {
+			keys[0] = p->angle.find(frame);
+			keys[1] = p->offset.find(frame);
+			keys[2] = p->visible.find(frame);
 		}
-		//if there is a keyframe there, copy mode
-		if(i->frame==frame) out.mode = i->mode;
+		if(p->part>=0 && s<pose.size()) evaluateBaked(s, frame, keys, pose.angle[s], pose.offset[s], pose.visible[s]);
 	}
-	//Deal with void fon non loops
-	for(int i=0; i<3; i++) {
-		if( !a[i] ) a[i] = b[i];
-		if( !b[i] ) b[i] = a[i];
-		if( !a[i] ) a[i] = b[i] = &nullFrame;
+}
+
+void Animation::evaluateBaked(int slot, int frame, const int* keys, float& angle, QPointF& offset, signed char& visible) {
+	const PartAnim& anim = m_frames.constData()[slot];
+	BakedFrame* baked = bakedFrame(frame, slot);
+	if(baked && baked->valid) {
+		++m_bakeHits;
+		angle = baked->angle;
+		offset = baked->offset;
+		visible = baked->visible;
+		return;
+	}
+	++m_bakeMisses;
+	int find[3];
+	if(!keys) {
+		find[0] = anim.angle.find(frame);
+		find[1] = anim.offset.find(frame);
+		find[2] = anim.visible.find(frame);
+		keys = find;
 	}
+	evaluate(anim, frame, keys, angle, offset, visible);
+	if(baked) {
+		baked->angle = angle;
+		baked->offset = offset;
+		baked->visible = visible;
+		baked->valid = true;
+	}
+}
 
-	//Interpolate values
-	out.angle =    interpolate(frame, a[0]->frame, b[0]->frame, a[0]->angle, b[0]->angle, true);
-	out.offset.rx() = interpolate(frame, a[1]->frame, b[1]->frame, a[1]->offset.x(), b[1]->offset.x());
-	out.offset.ry() = interpolate(frame, a[1]->frame, b[1]->frame, a[1]->offset.y(), b[1]->offset.y());
-	out.visible = a[2]==&nullFrame? !part->hidden(): a[2]->frame<=b[2]->frame?a[2]->visible: b[2]->visible;
+Frame Animation::frameDataAt(float time, Part* part) {
+	time = wrapTime(time);
+	if(time==floor(time)) return frameData((int)time, part);
+	const PartAnim* list = findPart(part);
+	if(!list || list->empty()) return part->hidden()? nullFrameHidden: nullFrame;
+	const PartAnim& anim = *list;
 
+	//Output frame - not a keyframe as it is between frames
+	Frame out;
+	out.frame = (int)time;
+	out.mode = 0;
+	signed char visible;
+	int next = (int)ceil(time);
+	int keys[3] = { anim.angle.find(next), anim.offset.find(next), anim.visible.find(next) };
+	evaluate(anim, time, keys, out.angle, out.offset, visible);
+	out.visible = visible<0? !part->hidden(): visible;
 	return out;
 }
 
+void Animation::evaluatePoseAt(float time, PoseBuffer& pose) const {
+	evaluateBatch(wrapTime(time), pose);
+}
+
+void Animation::evaluateBatch(float time, PoseBuffer& pose) const {
+	//Parts without animation stay at rest
+	pose.angle.fill(0);
+	pose.offset.fill(QPointF());
+	pose.visible.fill(-1);
+
+	//Gather interpolation terms for each channel: angles, then offset x, then offset y
+	int n = pose.size();
+	pose.lerp.resize(n * 12);
+	pose.lerp.fill(0);
+	float* va = pose.lerp.data();
+	float* vb = va + n*3;
+	float* vt = vb + n*3;
+	float* out = vt + n*3;
+	int next = (int)ceil(time);
+	int a, b;
+	const PartAnim* p = m_frames.constData();
+	for(int s=0; s<m_frames.size() && s<n; s++, p++) {
+		if(p->part<0) continue;
+		if(p->angle.bracketAt(p->angle.find(next), time, m_loop, a, b)) {
+			const Track<float>& t = p->angle;
+			va[s] = t.values[a];
+			vb[s] = t.values[b];
+			lerpTerms(time, t.frames[a], t.frames[b], va[s], vb[s], vt[s]);
+		}
+		if(p->offset.bracketAt(p->offset.find(next), time, m_loop, a, b)) {
+			const Track<QPointF>& t = p->offset;
+			int x = n+s, y = n*2+s;
+			va[x] = t.values[a].x(); vb[x] = t.values[b].x();
+			va[y] = t.values[a].y(); vb[y] = t.values[b].y();
+			lerpTerms(time, t.frames[a], t.frames[b], va[x], vb[x], vt[x]);
+			lerpTerms(time, t.frames[a], t.frames[b], va[y], vb[y], vt[y]);
+		}
+		if(p->visible.bracketAt(p->visible.find(next), time, m_loop, a, b)) {
+			const Track<bool>& t = p->visible;
+			pose.visible[s] = t.frames[a]<=t.frames[b]? t.values[a]: t.values[b];
+		}
+	}
+
+	//Interpolate everything at once
+	interpolateAngles(va, vb, vt, out, n);
+	interpolateValues(va+n, vb+n, vt+n, out+n, n*2);
+	for(int s=0; s<n; s++) {
+		pose.angle[s] = out[s];
+		pose.offset[s] = QPointF(out[n+s], out[n*2+s]);
+	}
+}
+
+float Animation::wrapTime(float time) const {
+	if(m_loop) {
+		time = fmod(time, (float)m_frameCount);
+		if(time<0) time += m_frameCount;
+	} else if(time > m_frameCount-1) time = m_frameCount-1;
+	else if(time < 0) time = 0;
+	return time;
+}
+
+void Animation::evaluate(const PartAnim& anim, float time, const int* keys, float& angle, QPointF& offset, signed char& visible) const {
+	//Interpolate values between the keys either side of time
+	int a, b;
+	if(anim.angle.bracketAt(keys[0], time, m_loop, a, b)) {
+		const Track<float>& t = anim.angle;
+		angle = interpolate(time, t.frames[a], t.frames[b], t.values[a], t.values[b], true);
+	} else angle = 0;
+	if(anim.offset.bracketAt(keys[1], time, m_loop, a, b)) {
+		const Track<QPointF>& t = anim.offset;
+		offset.rx() = interpolate(time, t.frames[a], t.frames[b], t.values[a].x(), t.values[b].x());
+		offset.ry() = interpolate(time, t.frames[a], t.frames[b], t.values[a].y(), t.values[b].y());
+	} else offset = QPointF();
+	if(anim.visible.bracketAt(keys[2], time, m_loop, a, b)) {
+		const Track<bool>& t = anim.visible;
+		visible = t.frames[a]<=t.frames[b]? t.values[a]: t.values[b];
+	} else visible = -1;
+}
+
+void Animation::lerpTerms(float frame, int fa, int fb, float& a, float& b, float& t) const {
+	//Same as interpolate, with the angle wrap left to the kernel
+	t = 0;
+	if(frame==fa || fa==fb) { b = a; return; }
+	if(fb<fa) fb += m_frameCount;
+	if(frame<fa) frame += m_frameCount;
+	t = (float)(frame-fa)/(fb-fa);
+}
+
 float Animation::interpolate(float frame, int fa, int fb, float a, float b, bool angle) const {
 	if(frame==fa || fa==fb) return a;
 	if(fb<fa) fb += m_frameCount;
@@ -117,44 +370,100 @@ float Animation::interpolate(float frame, int fa, int fb, float a, float b, bool
 }
 
 
-void Animation::insertFrame(int index) {
-	for(PartMap::Iterator p = m_frames.begin(); p!=m_frames.end(); p++) {
-		for(PartAnim::Iterator i=p->begin(); i!=p->end(); i++) {
-			if(i->frame >= index) i->frame++;
-		}
+void Animation::insertFrames(int index, int count) {
+	if(count<=0) return;
+	for(int i=0; i<m_frames.size(); i++) {
+		PartAnim& p = m_frames[i];
+		p.angle.shift(index, count);
+		p.offset.shift(index, count);
+		p.visible.shift(index, count);
 	}
-	setFrameCount( m_frameCount+1 );
-}
-void Animation::deleteFrame(int index) {
-	for(PartMap::iterator p = m_frames.begin(); p!=m_frames.end(); p++) {
-		for(PartAnim::Iterator i=p->begin(); i!=p->end(); i++) {
-			if(i->frame==index) {
-				i = p->erase(i);
-				if(i==p->end()) break; //stop it going over the end
-			}
-			if(i->frame > index) i->frame--;
-		}
+	for(int m=0; m<3; m++) {
+		if(index>=0 && index<m_keyCount[m].size()) m_keyCount[m].insert(index, count, 0);
+	}
+	invalidate();
+	clearBake();
+	setFrameCount( m_frameCount+count );
+}
+void Animation::deleteFrames(int index, int count) {
+	if(count<=0) return;
+	for(int i=0; i<m_frames.size(); i++) {
+		PartAnim& p = m_frames[i];
+		p.angle.removeFrames(index, count);
+		p.offset.removeFrames(index, count);
+		p.visible.removeFrames(index, count);
+	}
+	for(int m=0; m<3; m++) {
+		int n = qMin(count, m_keyCount[m].size()-index);
+		if(index>=0 && n>0) m_keyCount[m].remove(index, n);
 	}
-	setFrameCount( m_frameCount-1 );
+	invalidate();
+	clearBake();
+	setFrameCount( m_frameCount-count );
+}
+
+//// //// //// //// //// //// //// //// Bake Table //// //// //// //// //// //// //// ////
+
+Animation::BakedFrame* Animation::bakedFrame(int frame, int slot) {
+	if(m_bakeSlots<0 || slot<0 || frame<0 || frame>=m_frameCount) return 0;
+	if(slot >= m_bakeSlots) {
+		//Allocate table wide enough for every animated slot
+		int width = qMax(slot+1, m_frames.size());
+		BakedFrame empty;
+		empty.valid = false;
+		m_bake.clear();
+		if((qint64)width * m_frameCount * (qint64)sizeof(BakedFrame) > m_bakeLimit) { m_bakeSlots = -1; return 0; }
+		m_bake.fill(empty, width * m_frameCount);
+		m_bakeSlots = width;
+	}
+	return &m_bake[ frame*m_bakeSlots + slot ];
+}
+
+void Animation::invalidateBake(int slot, int first, int last) {
+	if(slot<0 || slot>=m_bakeSlots) { clearBake(); return; }
+	if(first<0) first = 0;
+	if(last>=m_frameCount) last = m_frameCount-1;
+	for(int f=first; f<=last; f++) m_bake[ f*m_bakeSlots + slot ].valid = false;
 }
 
 //// //// //// //// //// //// //// //// Image Cache //// //// //// //// //// //// //// ////
 
-bool Animation::hasCache(int frame) {
-	return m_cache.size()>frame && !m_cache[frame].image.isNull();
+void Animation::invalidate() {
+	// Inserted or deleted frames shift the rest, so every image is outdated
+	m_revision = m_imageRevision = nextRevision();
+	m_frameRevision.clear();
+}
+void Animation::invalidateFrames(int first, int last) {
+	m_revision = nextRevision();
+	if(first<0) first = 0;
+	if(last>=m_frameCount) last = m_frameCount-1;
+	if(first>last) return;
+	if(m_frameRevision.size() < m_frameCount) m_frameRevision.resize(m_frameCount);
+	for(int f=first; f<=last; f++) m_frameRevision[f] = m_revision;
+}
+int Animation::frameRevision(int frame) const {
+	if(frame<0 || frame>=m_frameRevision.size()) return m_imageRevision;
+	return qMax(m_imageRevision, m_frameRevision[frame]);
+}
+
+bool Animation::hasCache(int frame) const {
+	return FrameCache::instance().contains(this, frame, frameRevision(frame));
 }
 void Animation::cacheFrame(int frame, QPixmap* image, const QPoint& point) {
-	// Resize cache
-	while(m_cache.size() > frameCount()) m_cache.pop_back();
-	while(m_cache.size() < frame) m_cache.push_back( CachedImage() );
-	// Cache frame
 	CachedImage data;
 	data.image = *image;
 	data.point = point;
-	m_cache.insert(frame, data);
+	cacheFrame(frame, data);
 }
-const Animation::CachedImage& Animation::getCachedImage(int frame) {
-	return m_cache.at(frame);
+void Animation::cacheFrame(int frame, const CachedImage& data) {
+	if(frame<0 || frame>=m_frameCount) return;
+	CachedImage cached = data;
+	if(cached.revision<0) cached.revision = m_revision;
+	FrameCache::instance().insert(this, frame, cached);
+}
+Animation::CachedImage Animation::getCachedImage(int frame, bool outdated) const {
+	CachedImage cached = FrameCache::instance().get(this, frame);
+	if(!outdated && cached.revision<frameRevision(frame)) return CachedImage();
+	return cached;
 }
-
 
@@ -6,6 +6,8 @@
 #include <QImage>
 #include <QPixmap>
 #include <QMap>
+#include <QVector>
+#include <QTransform>
 
 class Part;
 
@@ -17,9 +19,114 @@ struct Frame {
 	bool visible;	//Part visible?
 };
 
+/** Local frame data for every part slot, filled by Animation::evaluatePose */
+struct PoseBuffer {
+	QVector<float>       angle;		// Local angle
+	QVector<QPointF>     offset;	// Local offset from rest position
+	QVector<signed char> visible;	// Visibility, or -1 if not animated
+	QVector<float>       lerp;		// Scratch space for batched interpolation
+
+	int size() const { return angle.size(); }
+	void resize(int count) { angle.resize(count); offset.resize(count); visible.resize(count); }
+};
+
+/** Keys for a single animation channel, stored as sorted frame and value arrays.
+ * The arrays are implicitly shared, so copied animations share keys until a track is modified */
+template<typename T> struct Track {
+	QVector<int> frames;	// Key frame numbers, sorted
+	QVector<T>   values;	// Key values
+
+	int size() const { return frames.size(); }
+	bool empty() const { return frames.empty(); }
+
+	// Index of the first key at or after frame
+	int find(int frame) const {
+		int lo=0, hi=frames.size();
+		const int* f = frames.constData();
+		while(lo<hi) {
+			int mid = (lo+hi)/2;
+			if(f[mid] < frame) lo = mid+1;
+			else hi = mid;
+		}
+		return lo;
+	}
+	// Is there a key at this frame
+	bool isKey(int frame) const {
+		int i = find(frame);
+		return i<frames.size() && frames[i]==frame;
+	}
+	// Add or replace a key. Returns true if a new key was added
+	bool set(int frame, const T& value) {
+		int i = find(frame);
+		if(i<frames.size() && frames[i]==frame) { values[i] = value; return false; }
+		frames.insert(i, frame);
+		values.insert(i, value);
+		return true;
+	}
+	// Remove the key at frame if there is one
+	bool remove(int frame) {
+		int i = find(frame);
+		if(i>=frames.size() || frames[i]!=frame) return false;
+		frames.remove(i);
+		values.remove(i);
+		return true;
+	}
+	// Move all keys at or after frame by delta
+	void shift(int frame, int delta) {
+		int* f = frames.data();
+		for(int i=find(frame); i<frames.size(); i++) f[i] += delta;
+	}
+	// Remove count frames starting at frame, closing the gap
+	void removeFrames(int frame, int count) {
+		int i = find(frame);
+		int n = find(frame+count) - i;
+		if(n) { frames.remove(i, n); values.remove(i, n); }
+		int* f = frames.data();
+		for(; i<frames.size(); i++) f[i] -= count;
+	}
+	// Advance a key index from find(previous frame) to find(frame) for a later frame
+	int advance(int i, int frame) const {
+		const int* f = frames.constData();
+		while(i<frames.size() && f[i]<frame) i++;
+		return i;
+	}
+	// Get the keys either side of frame. Returns false if there are no keys
+	bool bracket(int frame, bool loop, int& a, int& b) const {
+		return bracketAt(find(frame), frame, loop, a, b);
+	}
+	// Get the keys either side of time where i is the first key at or after time
+	bool bracketAt(int i, float time, bool loop, int& a, int& b) const {
+		if(frames.empty()) return false;
+		a = b = -1;
+		if(i<frames.size()) b = i;
+		if(b>=0 && frames[b]==time) a = b;
+		else if(i>0) a = i-1;
+		if(loop) {
+			if(a<0) a = frames.size()-1;
+			if(b<0) b = 0;
+		}
+		if(a<0) a = b;
+		if(b<0) b = a;
+		return true;
+	}
+};
+
+class Animation;
+
+/** Remembers the key segment of every channel between evaluations, so frames played in order evaluate in constant time */
+struct PoseCursor {
+	const Animation* animation;	// Animation the cursor was built for
+	int revision;			// Animation revision the cursor was built for
+	int frame;			// Last evaluated frame
+	QVector<int> keys;		// Index of the first key at or after frame, for each part channel
+	PoseCursor() : animation(0), revision(-1), frame(0) {}
+	void reset() { animation = 0; }
+};
+
 class Animation {
 	public:
 	Animation();
+	Animation(const Animation& other);	// Copy shares keyframes, but not rendered frames
 	~Animation();
 
 	const QString& name() const { return m_name; }		// Get animation name
@@ -29,9 +136,9 @@ class Animation {
 	void setFrameRate(float fps) { m_rate = fps; }		// Set frame rate
 
 	int frameCount() const { return m_frameCount; }		// Get the number of frames
-	void setFrameCount(int c) { m_frameCount = c; }		// Set the number of frames
+	void setFrameCount(int c) { m_frameCount = c; clearBake(); invalidate(); }	// Set the number of frames
 
-	void setLoop(bool loop) { m_loop=loop; }		// Set whether tha animation loops
+	void setLoop(bool loop) { m_loop=loop; clearBake(); invalidate(); }	// Set whether tha animation loops
 	bool loop() const { return m_loop; }			// Does the animation loop
 
 	enum FrameType { NONE=0, ANGLE=1, POS=2, VIS=4 };	// Keyframe elements
@@ -39,22 +146,46 @@ class Animation {
 	int isKeyframe(int frame, Part* part);			// Is a frame a keyframe
 	int isKeyframe(int frame);				// Is a frame keyed on any parts
 	Frame frameData(int frame, Part* part);			// Get interpolated data for a frame
-
+	void evaluatePose(int frame, PoseBuffer& pose) const;	// Get interpolated data for all part slots
+	void evaluatePose(int frame, PoseBuffer& pose, PoseCursor& cursor);	// Sequential evaluation, uses the bake table
+	Frame frameDataAt(float time, Part* part);		// Get interpolated data at a fractional frame
+	void evaluatePoseAt(float time, PoseBuffer& pose) const;	// Get interpolated data for all slots at a fractional frame
+	float wrapTime(float time) const;			// Wrap a fractional frame into the animation range
+	float timeAt(float seconds) const { return wrapTime(seconds * m_rate); }	// Fractional frame at a time in seconds
+
+	void setBakeLimit(int bytes) { m_bakeLimit=bytes; clearBake(); }	// Memory ceiling for the baked pose table, 0 disables it
+	int  bakeLimit() const { return m_bakeLimit; }		// Get the baked pose table memory ceiling
+	int  bakeHits() const { return m_bakeHits; }		// Number of evaluations read from the bake table
+	int  bakeMisses() const { return m_bakeMisses; }	// Number of evaluations that had to interpolate
+	void resetBakeStats() { m_bakeHits = m_bakeMisses = 0; }
+
+	int revision() const { return m_revision; }		// Changes whenever keyframes, frame count, looping or controller states change
+	int frameRevision(int frame) const;			// Revision at which a frame last changed
 	QList<int> parts() const;				// Get a list of all the parts with keyframes
+	QList<Frame> redundantKeys(Part* part, float angleTolerance, float offsetTolerance) const;	// Keys that interpolation reproduces within tolerance. mode is the channels to remove
 
 	void setControllerState(int id, bool active);	// Set theactive state of a controller
 	bool getControllerState(int id) const;			// Is a controller active?
 
-	void insertFrame(int index);				// Insert a frame at index
-	void deleteFrame(int index);				// delete a frame
+	void insertFrames(int index, int count=1);		// Insert frames at index
+	void deleteFrames(int index, int count=1);		// Delete frames and their keys
 	
 	int getID() const { return m_id; }			// Get animation ID
 	void setID(int id) { m_id = id; }			// Set animation ID
 
-	struct CachedImage { QPixmap image; QPoint point; };
+	struct CachedPart { QRect region; QTransform transform; };	// Where a part was drawn. Null region if not drawn
+	struct CachedImage {
+		QPixmap image;			// Frame image
+		QPoint point;			// Scene position of the image
+		QVector<CachedPart> parts;	// Drawn parts by slot, used to re-render only what changed
+		uint layout;			// Compositor layout the image was rendered with
+		int revision;			// Animation revision the image was rendered from, -1 for the current one
+		CachedImage() : layout(0), revision(-1) {}
+	};
 	void cacheFrame(int frame, QPixmap*, const QPoint&);	// Cache a pre-rendered animation frame
-	bool hasCache(int frame);				// Is this frame cached?
-	const CachedImage& getCachedImage(int frame);		// Get frame image
+	void cacheFrame(int frame, const CachedImage& data);	// Cache a frame with its part regions
+	bool hasCache(int frame) const;				// Is this frame cached, and rendered since it last changed?
+	CachedImage getCachedImage(int frame, bool outdated=false) const;	// Get frame image from the frame cache. Null if outdated, unless asked for
 
 	static Frame nullFrame;			//Null frame
 	static Frame nullFrameHidden;		//Null frame
@@ -64,15 +195,44 @@ class Animation {
 	bool m_loop;				// Is this animation looped?
 	int m_frameCount;			// Number of frames
 	float m_rate;				// Playback rate (fps)
-	typedef QList<Frame> PartAnim;		// Animation data struct
-	typedef QMap<int, PartAnim> PartMap;	// Part animation map
-	PartMap m_frames;			// One animation per part
+	int m_revision;				// Changes when frames change, unique across animations
+	int m_imageRevision;			// Revision at which every frame last changed
+	QVector<int> m_frameRevision;		// Revision at which each frame last changed, if later
+	QVector<int> m_keyCount[3];		// Number of parts keyed per frame, for each channel
+
+	struct BakedFrame { QPointF offset; float angle; signed char visible; bool valid; };
+	QVector<BakedFrame> m_bake;		// Baked pose table, frame major
+	int m_bakeSlots;			// Slots per frame in the bake table, -1 if over the memory limit
+	int m_bakeLimit;			// Bake table memory ceiling in bytes
+	int m_bakeHits, m_bakeMisses;		// Bake table statistics
+	struct PartAnim {			// Animation data struct
+		Track<float>   angle;		// ANGLE channel
+		Track<QPointF> offset;		// POS channel
+		Track<bool>    visible;		// VIS channel
+		int            part;		// Part id, -1 if the slot is unused
+		PartAnim() : part(-1) {}
+		bool empty() const { return angle.empty() && offset.empty() && visible.empty(); }
+	};
+	QVector<PartAnim> m_frames;		// Part animations, indexed by project part slot
 
 	QMap<int, bool> m_ikStates;	// Which ik controllers are active for this animation
 
-	QList<CachedImage> m_cache;		// Rendered frame images
-
-	PartAnim& partList(Part* part);		// Get/create animation frame list for a part
+	PartAnim* partList(Part* part);		// Get/create animation frame list for a part
+	const PartAnim* findPart(Part* part) const;	// Get animation frame list for a part if it has one
+	Animation& operator=(const Animation&);		// Not implemented
+	int keyMode(const PartAnim& anim, int frame) const;	// Which channels are keyed at frame
+	void countKey(int channel, int frame, int delta);	// Update the per frame key summary
+	void evaluate(const PartAnim& anim, float time, const int* keys, float& angle, QPointF& offset, signed char& visible) const;
+	void evaluateBaked(int slot, int frame, const int* keys, float& angle, QPointF& offset, signed char& visible);
+	void evaluateBatch(float time, PoseBuffer& pose) const;	// Evaluate all slots with the vector kernels
+	void lerpTerms(float frame, int fa, int fb, float& va, float& vb, float& t) const;	// Set up terms for interpolate
+
+	BakedFrame* bakedFrame(int frame, int slot);		// Get/allocate a bake table entry
+	void invalidateBake(int slot, int first, int last);	// Invalidate a frame range of one slot
+	void clearBake() { m_bake.clear(); m_bakeSlots = 0; }	// Invalidate the whole bake table
+	void invalidate();					// New revision, outdates every cached frame image
+	void invalidateFrames(int first, int last);		// New revision, outdates the cached images of a frame range
+	static int nextRevision();				// Unique revision number
 	float interpolate(float frame, int fa, int fb, float va, float vb, bool angle=false) const;
 };
 
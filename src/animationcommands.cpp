@@ -51,6 +51,7 @@ void DeleteAnimation::execute() {
 	QList<int> parts = anim->parts();
 	for(int i=0; i<parts.size(); i++) {
 		Part* part = project()->getPart( parts[i] );
+		if(!part) continue;	// Tracks of deleted parts stay in the animation
 		for(int f=0; f<anim->frameCount(); f++) {
 			if(anim->isKeyframe(f, part)) {
 				Keyframe key;
@@ -97,14 +98,14 @@ void RenameAnimation::rename(const QString& name) {
 
 //// //// //// //// //// //// //// //// Insert Frame //// //// //// //// //// //// //// ////
 
-InsertFrame::InsertFrame(Animation* anim, int frame) : AnimationCommand(anim), m_frame(frame) {}
+InsertFrame::InsertFrame(Animation* anim, int frame, int count) : AnimationCommand(anim), m_frame(frame), m_count(count) {}
 void InsertFrame::execute() {
-	getAnimation()->insertFrame(m_frame);
+	getAnimation()->insertFrames(m_frame, m_count);
 	project()->setCurrent( getAnimation() );
 	updateTable();
 }
 void InsertFrame::undo() {
-	getAnimation()->deleteFrame(m_frame);
+	getAnimation()->deleteFrames(m_frame, m_count);
 	project()->setCurrent( getAnimation() );
 	updateTable();
 }
@@ -112,33 +113,39 @@ void InsertFrame::undo() {
 
 //// //// //// //// //// //// //// //// Delete Frame //// //// //// //// //// //// //// ////
 
-DeleteFrame::DeleteFrame(Animation* anim, int frame) : AnimationCommand(anim), m_frame(frame) {}
+DeleteFrame::DeleteFrame(Animation* anim, int frame, int count) : AnimationCommand(anim), m_frame(frame), m_count(count) {}
 void DeleteFrame::execute() {
 	//Save keys
 	Animation* anim = getAnimation();
 	QList<int> parts = anim->parts();
-	for(int i=0; i<parts.size(); i++) {
-		Part* part = project()->getPart( parts[i] );
-		if(anim->isKeyframe(m_frame, part)) {
-			Frame data = anim->frameData(m_frame, part);
-			data.frame = parts[i];
-			m_keys.push_back(data);
+	m_keys.clear();
+	for(int f=m_frame; f<m_frame+m_count; f++) {
+		if(!anim->isKeyframe(f)) continue;
+		for(int i=0; i<parts.size(); i++) {
+			Part* part = project()->getPart( parts[i] );
+			if(!part) continue;	// Tracks of deleted parts stay in the animation
+			if(anim->isKeyframe(f, part)) {
+				Keyframe key;
+				key.part = parts[i];
+				key.data = anim->frameData(f, part);
+				m_keys.push_back(key);
+			}
 		}
 	}
-	//delete frame
-	anim->deleteFrame(m_frame);
+	//delete frames
+	anim->deleteFrames(m_frame, m_count);
 	project()->setCurrent( anim );
 	updateTable();
 	
 }
 void DeleteFrame::undo() {
 	Animation* anim = getAnimation();
-	//insert frame
-	anim->insertFrame(m_frame);
+	//insert frames
+	anim->insertFrames(m_frame, m_count);
 	//Add keys
 	for(int i=0; i<m_keys.size(); i++) {
-		Part* part = project()->getPart( m_keys[i].frame );
-		anim->setKeyframe(m_frame, part, m_keys[i]);
+		Part* part = project()->getPart( m_keys[i].part );
+		anim->setKeyframe(m_keys[i].data.frame, part, m_keys[i].data);
 	}
 	project()->setCurrent( anim );
 	updateTable();
@@ -169,3 +176,50 @@ bool SetFrames::combine(Command* next) {
 	return true;
 }
 
+//// //// //// //// //// //// //// //// Reduce Keys //// //// //// //// //// //// //// ////
+
+ReduceKeys::ReduceKeys(Animation* anim, float angleTolerance, float offsetTolerance)
+	: AnimationCommand(anim), m_angleTolerance(angleTolerance), m_offsetTolerance(offsetTolerance) {}
+QList<ReduceKeys::Keyframe> ReduceKeys::findKeys(Project* project, Animation* anim, float angleTolerance, float offsetTolerance) {
+	QList<Keyframe> keys;
+	QList<int> parts = anim->parts();
+	for(int i=0; i<parts.size(); i++) {
+		Part* part = project->getPart( parts[i] );
+		if(!part) continue;	// Tracks of deleted parts stay in the animation
+		QList<Frame> remove = anim->redundantKeys(part, angleTolerance, offsetTolerance);
+		for(int j=0; j<remove.size(); j++) {
+			Keyframe key;
+			key.part = parts[i];
+			key.mode = remove[j].mode;
+			key.data = anim->frameData(remove[j].frame, part);
+			keys.push_back(key);
+		}
+	}
+	return keys;
+}
+int ReduceKeys::count(Project* project, Animation* anim, float angleTolerance, float offsetTolerance) {
+	return findKeys(project, anim, angleTolerance, offsetTolerance).size();
+}
+void ReduceKeys::execute() {
+	Animation* anim = getAnimation();
+	//Save the original keys, then clear the redundant channels
+	m_keys = findKeys(project(), anim, m_angleTolerance, m_offsetTolerance);
+	for(int i=0; i<m_keys.size(); i++) {
+		Frame data = m_keys[i].data;
+		data.mode &= ~m_keys[i].mode;
+		anim->setKeyframe(data.frame, project()->getPart( m_keys[i].part ), data);
+	}
+	project()->setCurrent( anim );
+	updateTable();
+}
+void ReduceKeys::undo() {
+	Animation* anim = getAnimation();
+	for(int i=0; i<m_keys.size(); i++) {
+		Part* part = project()->getPart( m_keys[i].part );
+		Frame data = m_keys[i].data;
+		anim->setKeyframe(data.frame, part, data);
+	}
+	project()->setCurrent( anim );
+	updateTable();
+}
+
@@ -62,23 +62,26 @@ class RenameAnimation : public AnimationCommand {
 
 class InsertFrame : public AnimationCommand {
 	public:
-	InsertFrame(Animation* anim, int frame);
-	QString text() const { return "insert frame"; }
+	InsertFrame(Animation* anim, int frame, int count=1);
+	QString text() const { return m_count>1? "insert frames": "insert frame"; }
 	void execute();
 	void undo();
 	private:
 	int m_frame;
+	int m_count;
 };
 
 class DeleteFrame : public AnimationCommand {
 	public:
-	DeleteFrame(Animation* anim, int frame);
-	QString text() const { return "delete frame"; }
+	DeleteFrame(Animation* anim, int frame, int count=1);
+	QString text() const { return m_count>1? "delete frames": "delete frame"; }
 	void execute();
 	void undo();
 	private:
 	int m_frame;
-	QList<Frame> m_keys;	// Need to store deleted keyframes
+	int m_count;
+	struct Keyframe { int part; Frame data; };
+	QList<Keyframe> m_keys;	// Need to store deleted keyframes
 };
 
 class SetFrames : public AnimationCommand {
@@ -93,6 +96,20 @@ class SetFrames : public AnimationCommand {
 	int m_oldCount, m_newCount;
 };
 
+class ReduceKeys : public AnimationCommand {
+	public:
+	ReduceKeys(Animation* anim, float angleTolerance, float offsetTolerance);
+	QString text() const { return "reduce keyframes"; }
+	void execute();
+	void undo();
+	int count() const { return m_keys.size(); }	// Number of keyframes changed
+	static int count(Project* project, Animation* anim, float angleTolerance, float offsetTolerance);	// Number of keyframes that would be changed
+	private:
+	float m_angleTolerance, m_offsetTolerance;
+	struct Keyframe { int part; int mode; Frame data; };
+	QList<Keyframe> m_keys;	// Original keyframes, and which channels were removed
+	static QList<Keyframe> findKeys(Project* project, Animation* anim, float angleTolerance, float offsetTolerance);
+};
 
 #endif
 
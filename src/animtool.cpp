@@ -36,6 +36,7 @@ AnimTool::AnimTool(QWidget* parent) {
 	connect( actionExportAnimation, SIGNAL( triggered() ), this, SLOT( exportAnimation() ));
 	connect( actionExportAll, 	SIGNAL( triggered() ), this, SLOT( exportAll() ));
 	connect( m_export,		SIGNAL( refreshCache(Animation*,bool)), view, SLOT( generateCache(Animation*,bool) ));
+	connect( view,			SIGNAL( cacheProgress(int,int) ), this, SLOT( cacheProgress(int,int) ));
 
 	//Undo
 	m_commands = new CommandStack(this);
@@ -47,6 +48,7 @@ AnimTool::AnimTool(QWidget* parent) {
 	connect( m_commands, SIGNAL( updateFrame(int) ), this, SLOT( refreshFrames() ));
 	connect( m_commands, SIGNAL( updateTable() ), this, SLOT( refreshTable() ));
 	connect( m_commands, SIGNAL( updateView() ), this, SLOT( setFrame() ));
+	connect( m_commands, SIGNAL( updateRig() ), view, SLOT( invalidateParts() ));
 	connect( m_commands, SIGNAL( updatePart(Part*, const Frame&) ), view, SLOT( updatePart(Part*, const Frame&) ));
 	connect( m_commands, SIGNAL( updatePart(Part*, const Frame&) ), view, SLOT( updateControllers() ));
 	connect( m_commands, SIGNAL( updatePart(Part*, const Frame&) ), this, SLOT( updateDetails(Part*) ));
@@ -58,6 +60,9 @@ AnimTool::AnimTool(QWidget* parent) {
 
 	//Playback
 	m_timer = new QTimer(this);
+	m_timer->setSingleShot(true);	// Each frame schedules the next
+	m_playShown = m_playCached = 0;
+	m_stepping = false;
 	connect(m_timer, SIGNAL( timeout() ), this, SLOT( step() ));
 	connect(actionPlay, SIGNAL( triggered() ), this, SLOT( play() ));
 	connect(playRate,   SIGNAL( valueChanged(double) ), this, SLOT( setRate(double) ));
@@ -80,6 +85,7 @@ AnimTool::AnimTool(QWidget* parent) {
 	connect(actionZoomOut,	SIGNAL(triggered()), this, SLOT(zoomOut()));
 	connect(actionResetZoom,SIGNAL(triggered()), this, SLOT(resetZoom()));
 	connect(actionShowNulls,SIGNAL(triggered(bool)), view, SLOT( showNulls(bool) ));
+	connect(actionShowNulls,SIGNAL(triggered(bool)), m_export, SLOT( showNulls(bool) ));
 
 
 	//Parts treeview
@@ -90,6 +96,7 @@ AnimTool::AnimTool(QWidget* parent) {
 
 	//Parts events
 	connect( m_project,           SIGNAL( changedPart(int)), this,	SLOT( updatePartList(int) ));
+	connect( m_project,           SIGNAL( changedPart(int)), view,	SLOT( invalidateParts() ));
 	connect( m_project,           SIGNAL( changedSelection(Part*)), this,	SLOT( updatePartSelection() ));
 	connect( selectModel,         SIGNAL(currentChanged(const QModelIndex&, const QModelIndex&)), this, SLOT(selectPart(const QModelIndex&,const QModelIndex&)));
 	connect( listModel,           SIGNAL(itemChanged(QStandardItem*)), this, SLOT(renamePart(QStandardItem*)) );
@@ -114,6 +121,7 @@ AnimTool::AnimTool(QWidget* parent) {
 	connect( listModel,                SIGNAL(itemChanged(QStandardItem*)), this, SLOT(renameAnimation(QStandardItem*)) );
 	connect( actionAddAnimation,       SIGNAL( triggered() ), this, SLOT( addAnimation() ));
 	connect( actionDuplicateAnimation, SIGNAL( triggered() ), this, SLOT( cloneAnimation() ));
+	connect( actionReduceKeys,         SIGNAL( triggered() ), this, SLOT( reduceKeys() ));
 	connect( actionDeleteAnimation,    SIGNAL( triggered() ), this, SLOT( deleteAnimation() ));
 	connect( btnMoveUp,                SIGNAL( clicked() ),   actionMoveUp,   SLOT( trigger() ));
 	connect( btnMoveDown,              SIGNAL( clicked() ),   actionMoveDown, SLOT( trigger() ));
@@ -148,6 +156,7 @@ AnimTool::AnimTool(QWidget* parent) {
 	connect( controllerGoal,       SIGNAL( currentIndexChanged(int) ), this, SLOT( validateController() ));
 	connect( btnConfirmController, SIGNAL( clicked() ), this, SLOT( addController() ));
 	connect( m_project,            SIGNAL( changedController(int) ), this, SLOT(updateControllerList(int) ));
+	connect( m_project,            SIGNAL( changedController(int) ), view, SLOT( invalidateParts() ));
 	connect( controllerList,       SIGNAL( itemSelectionChanged() ), this, SLOT(controllerSelected() ));
 	connect( controllerList,       SIGNAL( itemChanged(QListWidgetItem*) ), this, SLOT( controllerStateChanged(QListWidgetItem*) ));
 
@@ -367,6 +376,7 @@ void AnimTool::renamePart(QStandardItem* item) {
 	if(parent != part->getParent()) {
 		part->setParent(parent); // Here as we are not executing the command HACK
 		m_commands->push( new MovePart(part, parent, partsList), false );
+		view->invalidateParts();
 	}
 }
 void AnimTool::addPart() {
@@ -428,6 +438,7 @@ void AnimTool::updateAnimation() {
 	btnCopyAnimation	-> setEnabled( anim );
 	btnDeleteAnimation	-> setEnabled( anim );
 	actionDuplicateAnimation-> setEnabled( anim );
+	actionReduceKeys	-> setEnabled( anim );
 	actionDeleteAnimation	-> setEnabled( anim );
 	frameDataContents	-> setEnabled( anim );
 	frameInfo		-> setEnabled( anim && m_project->currentPart() );
@@ -488,6 +499,22 @@ void AnimTool::cloneAnimation() {
 void AnimTool::deleteAnimation() {
 	m_commands->push( new DeleteAnimation( m_project->currentAnimation() ) );
 }
+void AnimTool::reduceKeys() {
+	Animation* anim = m_project->currentAnimation();
+	if(!anim) return;
+	bool ok;
+	double angle = QInputDialog::getDouble(this, "Reduce Keyframes", "Angle tolerance (degrees):", 0.5, 0, 180, 2, &ok);
+	if(!ok) return;
+	double offset = QInputDialog::getDouble(this, "Reduce Keyframes", "Offset tolerance (pixels):", 0.5, 0, 1000, 2, &ok);
+	if(!ok) return;
+	if(!ReduceKeys::count(m_project, anim, angle, offset)) {
+		statusbar->showMessage( "No redundant keyframes", 3000 );
+		return;
+	}
+	ReduceKeys* cmd = new ReduceKeys(anim, angle, offset);
+	m_commands->push( cmd );
+	statusbar->showMessage( QString("Reduced %1 keyframes").arg( cmd->count() ), 3000 );
+}
 void AnimTool::setAnimation(const QModelIndex& sel, const QModelIndex& last) {
 	if(m_noEvent) return;
 	Animation* anim = 0;
@@ -661,13 +688,33 @@ void AnimTool::setFrameCount(int c) {
 	Animation* anim = m_project->currentAnimation();
 	if(anim && anim->frameCount()!=c) m_commands->push( new SetFrames( anim, c ) );
 }
+void AnimTool::selectedFrames(int& first, int& count) const {
+	// Use the selected span of frames if it is contiguous and contains the current frame
+	int frame = m_project->frame();
+	int last = -1;
+	QSet<int> columns;
+	first = frame;
+	QModelIndexList sel = frameList->selectionModel()->selectedIndexes();
+	foreach(const QModelIndex& i, sel) {
+		if(columns.empty() || i.column() < first) first = i.column();
+		if(i.column() > last) last = i.column();
+		columns.insert( i.column() );
+	}
+	if(columns.empty() || first > frame || last < frame || columns.size() != last-first+1) first = last = frame;
+	count = last - first + 1;
+}
 void AnimTool::insertFrame() {
 	Animation* anim = m_project->currentAnimation();
-	m_commands->push( new InsertFrame(anim, m_project->frame()) );
+	int first, count;
+	selectedFrames(first, count);
+	m_commands->push( new InsertFrame(anim, first, count) );
 }
 void AnimTool::deleteFrame() {
 	Animation* anim = m_project->currentAnimation();
-	m_commands->push( new DeleteFrame(anim, m_project->frame()) );
+	int first, count;
+	selectedFrames(first, count);
+	if(count >= anim->frameCount()) count = anim->frameCount()-1; // Keep one frame
+	if(count>0) m_commands->push( new DeleteFrame(anim, first, count) );
 }
 
 //// //// //// //// //// //// //// //// Details panel //// //// //// //// //// //// //// ////
@@ -763,17 +810,24 @@ void AnimTool::selectFrame(const QModelIndex& sel, const QModelIndex& last) {
 	if(sel.isValid()) setFrame( sel.column() );
 }
 void AnimTool::setFrame(int frame) {
-	if(frame<0) frame = m_project->frame(); //Re-apply the current frame
+	int old = m_project->frame();
+	if(frame<0) frame = old; //Re-apply the current frame
 	Animation* anim = m_project->currentAnimation();
 	if(anim) {
 		m_project->setFrame( frame );
+		//Playback continues from a frame chosen while playing
+		if(frame!=old && !m_stepping && m_timer->isActive()) restartClock();
 		updateDetails( m_project->currentPart() );
 		//Update view
 		int before = onionBefore->isChecked()? onionSize->value(): 0;
 		int after  = onionAfter ->isChecked()? onionSize->value(): 0;
 		view->displayFrame( anim, frame, before, after );
 	} else view->displayFrame(0,0);
-	refreshFrames();
+	//While playing, only the old and new frame columns change
+	if(m_timer->isActive()) {
+		refreshFrames(old);
+		if(frame!=old) refreshFrames(frame);
+	} else refreshFrames();
 }
 void AnimTool::refreshFrames(int f) {
 	for(int i=0; i<m_frameModel->rowCount(); i++) {
@@ -834,19 +888,48 @@ void AnimTool::updateOnionSkin() {
 	printf("Set onionskin %d-%d\n", before, after);
 	view->setOnionSkin(before, after);
 }
+void AnimTool::cacheProgress(int done, int total) {
+	if(done < total) statusbar->showMessage( QString("Rendering frames %1/%2").arg(done).arg(total) );
+	else statusbar->clearMessage();
+}
 
 //// //// //// //// //// //// //// //// Playback //// //// //// //// //// //// //// ////
 
 void AnimTool::play(bool go) {
 	if(!go || m_timer->isActive()) { //Stop playback
 		m_timer->stop();
+		if(m_playShown) showPlaybackStats();
 	} else if(m_project->currentAnimation()->frameCount()>1) {
-		nextFrame();
+		Animation* anim = m_project->currentAnimation();
+		if(!anim->loop() && m_project->frame()==anim->frameCount()-1) setFrame(0);
+		m_playShown = m_playCached = m_playDropped = 0;
+		m_playWork = m_playStats = 0;
+		m_clock.start();
+		restartClock();
 		m_timer->start( 1000 / playRate->value() );
 	}
+	view->setPlayback( m_timer->isActive() );
 	btnPlay->setChecked( m_timer->isActive() );
 }
 
+void AnimTool::restartClock() {
+	m_playBase = m_clock.nsecsElapsed();
+	m_playStart = m_project->frame();
+	m_playTicks = 0;
+}
+
+void AnimTool::showPlaybackStats() {
+	float seconds = m_clock.nsecsElapsed() / 1e9;
+	QString stats = QString("Playback: %1 fps, %2 frames dropped, %3 ms per frame, %4 from cache")
+		.arg(seconds>0? m_playShown/seconds: 0, 0, 'f', 1)
+		.arg(m_playDropped)
+		.arg(m_playShown? m_playWork/1e6/m_playShown: 0, 0, 'f', 1)
+		.arg(m_playCached);
+	//Pose time is only meaningful if a pose was updated while playing
+	if(m_playCached < m_playShown) stats += QString(", last pose update %1 ms").arg(view->poseTime()/1e6, 0, 'f', 2);
+	statusbar->showMessage( stats, m_timer->isActive()? 0: 5000 );
+}
+
 void AnimTool::setLoop(bool loop) {
 	m_project->currentAnimation()->setLoop(loop);
 	setFrame( m_project->frame() ); //may have changed
@@ -854,14 +937,44 @@ void AnimTool::setLoop(bool loop) {
 
 void AnimTool::setRate(double fps) {
 	printf("Adjust %f\n", 1000/fps);
-	if(m_timer->isActive()) m_timer->setInterval( 1000 / fps );
+	if(m_timer->isActive()) restartClock();
 	if(m_project->currentAnimation()) m_project->currentAnimation()->setFrameRate( fps );
 }
 
 void AnimTool::step() {
 	Animation* anim = m_project->currentAnimation();
-	if(!anim->loop() && m_project->frame() == anim->frameCount()-1) { play(false); return; }
-	nextFrame();
+	if(!anim) { play(false); return; }
+	// Frame that should be showing now
+	double fps = playRate->value();
+	qint64 now = m_clock.nsecsElapsed();
+	int ticks = (now - m_playBase) * fps / 1e9;
+	if(ticks > m_playTicks) {
+		m_playDropped += ticks - m_playTicks - 1;
+		m_playTicks = ticks;
+		int frame = m_playStart + ticks;
+		int fc = anim->frameCount();
+		m_stepping = true;
+		if(!anim->loop() && frame >= fc-1) {
+			setFrame(fc-1);
+			m_stepping = false;
+			play(false);
+			return;
+		}
+		setFrame( frame % fc );
+		m_stepping = false;
+		++m_playShown;
+		if(view->isShowingCache()) ++m_playCached;
+		m_playWork += m_clock.nsecsElapsed() - now;
+		// Update statistics once a second
+		if(now - m_playStats >= 1000000000) {
+			m_playStats = now;
+			showPlaybackStats();
+		}
+	}
+	// Wake at the start of the next frame period
+	qint64 next = m_playBase + (qint64)((m_playTicks+1) * 1e9 / fps);
+	qint64 wait = next - m_clock.nsecsElapsed();
+	m_timer->start( wait>0? (wait+999999)/1000000: 0 );
 }
 
 
@@ -3,6 +3,7 @@
 
 
 #include "ui_anim.h" //The generated form from anim.ui
+#include <QElapsedTimer>
 
 #include "project.h"
 #include "tablemodel.h"
@@ -30,9 +31,24 @@ class AnimTool : public QMainWindow, private Ui::MainWindow {
 
 	int m_noEvent;			// Block events to change multiple spinboxes at once
 	QTimer* m_timer;		// Timer for playback
+	QElapsedTimer m_clock;		// Monotonic playback clock
+	qint64 m_playBase;		// Clock time frame timing is measured from
+	int m_playStart;		// Frame shown at m_playBase
+	int m_playTicks;		// Frame periods elapsed at the last shown frame
+	int m_playShown;		// Frames shown since playback started
+	int m_playCached;		// Frames shown from the frame cache, without a pose update
+	int m_playDropped;		// Frames skipped to keep up
+	qint64 m_playWork;		// Time spent showing frames, in nanoseconds
+	qint64 m_playStats;		// Clock time of the last statistics update
+	bool m_stepping;		// Frame is being changed by playback
+
+	void restartClock();		// Restart frame timing from the current frame
+	void showPlaybackStats();	// Show playback statistics in the status bar
 	CommandStack* m_commands;	// Command stack
 	Export* m_export;		// Export Dialog
 
+	void selectedFrames(int& first, int& count) const;	// Get the selected frame span
+
 	public slots:
 	
 	void supressEvents(bool=true);
@@ -79,8 +95,10 @@ class AnimTool : public QMainWindow, private Ui::MainWindow {
 	void setAnimation(const QModelIndex&, const QModelIndex&);
 	void moveAnimationUp();
 	void moveAnimationDown();
+	void reduceKeys();
 
 	void updateOnionSkin();
+	void cacheProgress(int done, int total);	// Show background rendering progress
 
 	void selectFrame(const QModelIndex&, const QModelIndex&);
 	void setFrameCount(int);
@@ -44,6 +44,7 @@ class CommandStack : public QObject {
 	void updateFrame(int);				// Signal frame has changed in table
 	void updateView();				// Signal view to redraw
 	void updatePart(Part* part, const Frame& data);	// Signal that part data has been modified
+	void updateRig();				// Signal that part hierarchy, rest data or stacking order has changed
 	void skipEvents(bool);				// Skip element changed events
 	void cleanStateChanged();			// Signal when the project is clea
 
@@ -82,6 +83,7 @@ class Command {
 	void updateFrame(int f)				{ m_stack->updateFrame(f); }
 	void updateView()				{ m_stack->updateView(); }
 	void updatePart(Part* part, const Frame& data)	{ m_stack->updatePart(part,data); }
+	void updateRig()				{ m_stack->updateRig(); }
 	void skipEvents(bool skip)			{ m_stack->skipEvents(skip); }
 
 	private:
@@ -0,0 +1,106 @@
+#include "compositor.h"
+#include "project.h"
+#include "part.h"
+#include <QPainter>
+#include <QtConcurrentMap>
+
+void Compositor::prepare(Project* project, bool hideNulls) {
+	m_rig.build(project, hideNulls);
+	// Convert part pixmaps, reusing images that have not changed
+	QHash<qint64, QImage> converted;
+	m_images.clear();
+	m_images.resize( project->slotCount() );
+	for(int i=0; i<project->slotCount(); i++) {
+		Part* part = project->slotPart(i);
+		if(!part || part->pixmap().isNull()) continue;
+		qint64 key = part->pixmap().cacheKey();
+		if(!converted.contains(key)) {
+			QHash<qint64, QImage>::const_iterator c = m_converted.constFind(key);
+			converted[key] = c!=m_converted.constEnd()? *c: part->pixmap().toImage().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+		}
+		m_images[i] = converted[key];
+	}
+	m_converted = converted;
+
+	//Layout hash, cached frames rendered with another layout must be fully re-rendered
+	const QVector<int>& order = m_rig.drawOrder();
+	m_layout = hideNulls;
+	for(int i=0; i<order.size(); i++) {
+		qint64 key = m_images[ order[i] ].cacheKey();
+		m_layout = m_layout*31 + order[i];
+		m_layout = m_layout*31 + qHash(key);
+	}
+}
+
+Rig Compositor::solve(const Animation* anim, int frame) const {
+	PoseBuffer pose;
+	pose.resize( m_rig.size() );
+	anim->evaluatePose(frame, pose);
+	Rig rig = m_rig;
+	rig.solve(pose, anim);
+	return rig;
+}
+
+QImage Compositor::render(const Animation* anim, int frame, QPoint& origin) const {
+	return render( solve(anim, frame), origin );
+}
+
+QImage Compositor::render(const Rig& rig, QPoint& origin) const {
+	//Size the target from the solved transforms
+	QRect rect = rig.bounds().toAlignedRect();
+	origin = rect.topLeft();
+	return render(rig, rect);
+}
+
+QImage Compositor::render(const Rig& rig, const QRect& area) const {
+	if(area.isEmpty()) return QImage();
+	//Draw parts overlapping the area back to front
+	const QVector<int>& order = rig.drawOrder();
+	QImage image(area.size(), QImage::Format_ARGB32_Premultiplied);
+	image.fill(0);
+	QPainter painter(&image);
+	QTransform offset = QTransform::fromTranslate(-area.x(), -area.y());
+	for(int i=0; i<order.size(); i++) {
+		int s = order[i];
+		if(m_images[s].isNull() || !rig.bounds(s).intersects(area)) continue;
+		painter.setTransform( rig.transform(s) * offset );
+		painter.drawImage( rig.rect(s).topLeft(), m_images[s] );
+	}
+	painter.end();
+	return image;
+}
+
+QVector<Animation::CachedPart> Compositor::parts(const Rig& rig) {
+	QVector<Animation::CachedPart> parts(rig.size());
+	for(int i=0; i<rig.size(); i++) {
+		parts[i].region = rig.bounds(i).toAlignedRect();
+		if(!parts[i].region.isNull()) parts[i].transform = rig.transform(i);
+	}
+	return parts;
+}
+
+// Renders a single frame, run by QtConcurrent
+struct RenderJob {
+	typedef Compositor::Rendered result_type;
+	const Compositor* compositor;
+	const Animation* anim;
+	RenderJob(const Compositor* c, const Animation* a) : compositor(c), anim(a) {}
+	Compositor::Rendered operator()(int frame) const {
+		Compositor::Rendered r;
+		Rig rig = compositor->solve(anim, frame);
+		r.frame = frame;
+		r.image = compositor->render(rig, r.origin);
+		r.parts = Compositor::parts(rig);
+		r.layout = compositor->layout();
+		return r;
+	}
+};
+
+QList<Compositor::Rendered> Compositor::render(const Animation* anim, const QList<int>& frames) const {
+	return QtConcurrent::blockingMapped< QList<Rendered> >(frames, RenderJob(this, anim));
+}
+
+QFuture<Compositor::Rendered> Compositor::renderAsync(const Animation* anim, const QList<int>& frames) const {
+	return QtConcurrent::mapped(frames, RenderJob(this, anim));
+}
+
@@ -0,0 +1,37 @@
+#ifndef _COMPOSITOR_
+#define _COMPOSITOR_
+
+#include <QImage>
+#include <QHash>
+#include <QFuture>
+#include "rig.h"
+
+/** Renders animation frames into images from a rig and the part images, without the graphics scene.
+ * prepare() must be called on the GUI thread whenever parts change. The render functions
+ * only read the snapshot, so they can run on any thread. */
+class Compositor {
+	public:
+	Compositor() : m_layout(0) {}
+	void prepare(Project* project, bool hideNulls=false);			// Snapshot the rig and part images
+	const Rig& rig() const { return m_rig; }				// Get the prepared rig
+	uint layout() const { return m_layout; }				// Changes when part images or stacking order change
+
+	Rig solve(const Animation* anim, int frame) const;			// Solve the rig for an animation frame
+	QImage render(const Animation* anim, int frame, QPoint& origin) const;	// Render an animation frame. origin is its scene position
+	QImage render(const Rig& rig, QPoint& origin) const;			// Render a solved rig
+	QImage render(const Rig& rig, const QRect& area) const;		// Render a scene area of a solved rig
+	static QVector<Animation::CachedPart> parts(const Rig& rig);		// Where each part of a solved rig is drawn
+
+	struct Rendered { int frame; QImage image; QPoint origin; QVector<Animation::CachedPart> parts; uint layout; };
+	QList<Rendered> render(const Animation* anim, const QList<int>& frames) const;	// Render frames in parallel on the global thread pool
+	QFuture<Rendered> renderAsync(const Animation* anim, const QList<int>& frames) const;	// Start rendering frames in the background, in list order
+
+	private:
+	Rig m_rig;				// Part hierarchy
+	QVector<QImage> m_images;		// Part images by slot
+	QHash<qint64, QImage> m_converted;	// Converted images by pixmap cache key
+	uint m_layout;				// Hash of the images and stacking order
+};
+
+#endif
+
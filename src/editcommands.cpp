@@ -56,6 +56,7 @@ void ChangeRest::setRest(const QPointF& pivot, const QPointF& rest, int flags) {
 	// If hidden has changed, calculate visibile
 	if(flags&4) data.visible = !part->hidden(); //FIXME should calculate visibility
 	// Fire update events
+	updateRig();
 	updatePart(part, data);
 }
 
@@ -1,6 +1,8 @@
 #include "export.h"
 #include "project.h"
 #include "animation.h"
+#include "framecache.h"
+#include "rig.h"
 
 #include <QPainter>
 #include <QFileDialog>
@@ -8,7 +10,7 @@
 #include <cstdio>
 #include <cmath>
 
-Export::Export(QWidget* parent) {
+Export::Export(QWidget* parent) : m_hideNulls(false) {
 	setupUi(this);
 	setWindowFlags( Qt::Dialog | Qt::WindowStaysOnTopHint );
 	animationList->setSortingEnabled(true);
@@ -55,20 +57,34 @@ void Export::exportFrame(Animation* anim, int frame) {
 	if(file!=QString::null) {
 		printf("Export Frame\n");
 		m_project->setCurrent(anim);
+		FrameCache::instance().pin(anim, frame);
+		if(!anim->hasCache(frame)) refreshCache(anim, false);
 		anim->getCachedImage(frame).image.save(file);
+		FrameCache::instance().unpin(anim, frame);
+	}
+}
+
+void Export::pinFrames(Animation* anim, bool pin) const {
+	FrameCache& cache = FrameCache::instance();
+	for(int i=0; i<anim->frameCount(); i++) {
+		if(pin) cache.pin(anim, i);
+		else cache.unpin(anim, i);
 	}
 }
 
 QRect Export::getBounds( const QList<Animation*>& list ) const {
-	// Get bounding box
+	// Get bounding box from the evaluated poses, nothing is rendered
+	Rig rig;
+	rig.build(m_project, m_hideNulls);
+	PoseBuffer pose;
+	pose.resize( rig.size() );
 	QRect box;
 	for(int a = 0; a<list.size(); a++) {
 		Animation* anim = list[a];
 		for(int i=0; i<anim->frameCount(); i++) {
-			QRect r   = anim->getCachedImage(i).image.rect();
-			QPoint p = anim->getCachedImage(i).point;
-			r.translate(p);
-			if(i==0 && a==0) box = r; else box |= r;
+			anim->evaluatePose(i, pose);
+			rig.solve(pose, anim);
+			box |= rig.bounds().toAlignedRect();
 		}
 	}
 	box.adjust(0,0,box.width()&1? 1:0, box.height()&1?1:0);	// Hack: Make even
@@ -76,6 +92,13 @@ QRect Export::getBounds( const QList<Animation*>& list ) const {
 }
 
 QPixmap* Export::buildSpriteSheet( const QList<Animation*>& list, bool animPerRow) {
+	// Get bounds, before rendering anything
+	QRect box = getBounds(list);
+	if(box.width()<0 || box.height()<0) {
+		printf("Error: Null image bounds\n");
+		return 0;
+	}
+
 	Animation* anim = m_project->currentAnimation();
 	// Get animation range
 	int longest = 1, total = 0;
@@ -83,18 +106,12 @@ QPixmap* Export::buildSpriteSheet( const QList<Animation*>& list, bool animPerRo
 		int fc = list[i]->frameCount();
 		if(fc>longest) longest = fc;
 		total += fc;
-		// Make sure animation is fully cached
+		// Make sure animation is fully cached, and stays cached until the sheet is built
+		pinFrames(list[i], true);
 		refreshCache(list[i], true);
 	}
 	m_project->setCurrent(anim);
 
-	// Get bounds
-	QRect box = getBounds(list);
-	if(box.width()<0 || box.height()<0) {
-		printf("Error: Null image bounds\n");
-		return 0;
-	}
-
 	// Output image size
 	int iw, ih;
 	if(animPerRow) {
@@ -120,8 +137,8 @@ QPixmap* Export::buildSpriteSheet( const QList<Animation*>& list, bool animPerRo
 	p.begin(image);
 	for(int a=0; a<list.size(); a++) {
 		for(int i=0; i<list[a]->frameCount(); i++) {
-			QPoint offset = list[a]->getCachedImage(i).point;
-			p.drawPixmap( point+offset-base, list[a]->getCachedImage(i).image );
+			Animation::CachedImage cached = list[a]->getCachedImage(i);
+			p.drawPixmap( point+cached.point-base, cached.image );
 			//DEBUG: Draw frame rect
 			//p.drawRect(box.translated(point-base));
 			point.rx() += box.width();
@@ -132,6 +149,7 @@ QPixmap* Export::buildSpriteSheet( const QList<Animation*>& list, bool animPerRo
 		}
 	}
 	p.end();
+	for(int a=0; a<list.size(); a++) pinFrames(list[a], false);
 	//Return image
 	return image;
 }
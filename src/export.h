@@ -22,6 +22,7 @@ class Export : public QDialog, private Ui::ExportDialog {
 	void save();
 	void cancel();
 	void exportFrame(Animation* anim, int frame);
+	void showNulls(bool show) { m_hideNulls = !show; }	// Match the view's null part visibility
 
 	signals:
 	void refreshCache(Animation* anim, bool override);
@@ -29,6 +30,8 @@ class Export : public QDialog, private Ui::ExportDialog {
 
 	protected:
 	Project* m_project;
+	bool m_hideNulls;	// Null parts are not drawn
+	void pinFrames(Animation* anim, bool pin) const;	// Pin or unpin all frames of an animation in the frame cache
 
 };
 
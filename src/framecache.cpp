@@ -0,0 +1,94 @@
+#include "framecache.h"
+
+#define DEFAULT_CACHE_BUDGET (256<<20)	// Default frame cache memory budget
+
+FrameCache& FrameCache::instance() {
+	static FrameCache cache;
+	return cache;
+}
+
+FrameCache::FrameCache() : m_budget(DEFAULT_CACHE_BUDGET), m_bytes(0), m_hits(0), m_misses(0), m_evictions(0) {
+}
+
+void FrameCache::setBudget(qint64 bytes) {
+	m_budget = bytes;
+	evict();
+}
+
+bool FrameCache::contains(const Animation* anim, int frame, int revision) const {
+	QHash<Key, Entry>::const_iterator i = m_entries.constFind( Key(anim, frame) );
+	return i!=m_entries.constEnd() && i->data.revision>=revision;
+}
+
+FrameCache::CachedImage FrameCache::get(const Animation* anim, int frame) {
+	QHash<Key, Entry>::iterator i = m_entries.find( Key(anim, frame) );
+	if(i==m_entries.end()) { ++m_misses; return CachedImage(); }
+	++m_hits;
+	//Move to most recently used
+	m_lru.erase(i->use);
+	i->use = m_lru.insert(m_lru.end(), i.key());
+	return i->data;
+}
+
+void FrameCache::insert(const Animation* anim, int frame, const CachedImage& data) {
+	remove(anim, frame);
+	Key key(anim, frame);
+	Entry& e = m_entries[key];
+	e.data = data;
+	e.bytes = (qint64)data.image.width() * data.image.height() * data.image.depth() / 8;
+	e.use = m_lru.insert(m_lru.end(), key);
+	m_bytes += e.bytes;
+	evict();
+}
+
+void FrameCache::remove(const Animation* anim, int frame) {
+	QHash<Key, Entry>::iterator i = m_entries.find( Key(anim, frame) );
+	if(i==m_entries.end()) return;
+	m_bytes -= i->bytes;
+	m_lru.erase(i->use);
+	m_entries.erase(i);
+}
+
+void FrameCache::remove(const Animation* anim) {
+	for(QHash<Key, Entry>::iterator i=m_entries.begin(); i!=m_entries.end();) {
+		if(i.key().first == anim) {
+			m_bytes -= i->bytes;
+			m_lru.erase(i->use);
+			i = m_entries.erase(i);
+		} else ++i;
+	}
+	for(QHash<Key, int>::iterator i=m_pins.begin(); i!=m_pins.end();) {
+		if(i.key().first == anim) i = m_pins.erase(i);
+		else ++i;
+	}
+}
+
+void FrameCache::removeImages() {
+	m_entries.clear();
+	m_lru.clear();
+	m_bytes = 0;
+}
+
+void FrameCache::pin(const Animation* anim, int frame) {
+	++m_pins[ Key(anim, frame) ];
+}
+
+void FrameCache::unpin(const Animation* anim, int frame) {
+	QHash<Key, int>::iterator i = m_pins.find( Key(anim, frame) );
+	if(i==m_pins.end()) return;
+	if(--i.value() <= 0) m_pins.erase(i);
+	evict();
+}
+
+void FrameCache::evict() {
+	QLinkedList<Key>::iterator i = m_lru.begin();
+	while(m_bytes > m_budget && i!=m_lru.end()) {
+		if(m_pins.contains(*i)) { ++i; continue; }
+		QHash<Key, Entry>::iterator e = m_entries.find(*i);
+		m_bytes -= e->bytes;
+		m_entries.erase(e);
+		i = m_lru.erase(i);
+		++m_evictions;
+	}
+}
+
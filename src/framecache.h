@@ -0,0 +1,56 @@
+#ifndef _FRAMECACHE_
+#define _FRAMECACHE_
+
+#include "animation.h"
+#include <QHash>
+#include <QLinkedList>
+#include <QPair>
+
+/** Rendered frame images of all animations, kept within a memory budget.
+ * The least recently used images are evicted first. Pinned frames are never evicted,
+ * so the budget may be exceeded while more frames are pinned than fit in it. */
+class FrameCache {
+	public:
+	typedef Animation::CachedImage CachedImage;
+	static FrameCache& instance();				// Global frame cache
+
+	void setBudget(qint64 bytes);				// Set the memory budget
+	qint64 budget() const { return m_budget; }		// Get the memory budget
+
+	bool contains(const Animation* anim, int frame, int revision) const;	// Is a frame cached from an animation revision or later?
+	CachedImage get(const Animation* anim, int frame);	// Get a frame image. Null image if not cached
+	void insert(const Animation* anim, int frame, const CachedImage& data);	// Add or replace a frame image
+	void remove(const Animation* anim, int frame);		// Remove a frame image
+	void remove(const Animation* anim);			// Remove all images and pins of an animation
+	void removeImages();					// Remove all images, keeping pins
+
+	void pin(const Animation* anim, int frame);		// Keep a frame while it is in use. Pins are counted
+	void unpin(const Animation* anim, int frame);		// Release a pinned frame
+
+	qint64 bytes() const { return m_bytes; }		// Memory used by cached images
+	int count() const { return m_entries.size(); }		// Number of cached images
+	int hits() const { return m_hits; }			// Successful lookups
+	int misses() const { return m_misses; }			// Failed lookups
+	int evictions() const { return m_evictions; }		// Images evicted to stay within budget
+	void resetStats() { m_hits = m_misses = m_evictions = 0; }
+
+	private:
+	FrameCache();
+	typedef QPair<const Animation*, int> Key;
+	struct Entry {
+		CachedImage data;
+		qint64 bytes;				// Estimated image memory
+		QLinkedList<Key>::iterator use;		// Position in the usage list
+	};
+	QHash<Key, Entry> m_entries;		// Cached images
+	QLinkedList<Key> m_lru;			// Usage order, least recently used first
+	QHash<Key, int> m_pins;			// Pin counts
+	qint64 m_budget;			// Memory budget in bytes
+	qint64 m_bytes;				// Memory in use
+	int m_hits, m_misses, m_evictions;	// Statistics
+
+	void evict();				// Evict unpinned images until within budget
+};
+
+#endif
+
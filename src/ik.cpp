@@ -1,5 +1,4 @@
 #include "ik.h"
-#include "view.h"
 #include <cmath>
 
 static const QPointF zero(0,0);
@@ -25,43 +24,52 @@ float calculateAngle(const QPointF& dir, const QPointF& goal) {
 	return (rt - rg) * 180 / 3.141592654;
 }
 
-void lookat(View* v, Part* pa, Part* pb, const QPointF& goal) {
-	QPointF d = pa->mapFromScene(pb->pos());
-	float ang = calculateAngle(d, goal - pa->pos());
-	v->setAbsoluteRotation( pa, ang );
+void lookat(IKTarget* t, int pa, int pb, const QPointF& goal) {
+	QPointF d = t->mapToPart(pa, t->position(pb));
+	float ang = calculateAngle(d, goal - t->position(pa));
+	t->setAbsoluteRotation( pa, ang );
 }
 
-void IKController::apply(View* v) const {
-	Part* parent = m_partA->getParent();
+IKChain IKController::chain() const {
+	IKChain c;
+	c.id = m_id;
+	c.partA = m_partA->slot();
+	c.partB = m_partB? m_partB->slot(): -1;
+	c.head = m_head->slot();
+	c.goal = m_goal->slot();
+	return c;
+}
+
+void IKChain::apply(IKTarget* t) const {
 	// Simple lookat mode
-	if(m_partB == 0) {
-		lookat(v, m_partA, m_head, m_goal->pos());
+	if(partB < 0) {
+		lookat(t, partA, head, t->position(goal));
 	}
 	// Two bone ik
 	else {
 
 		// Calculate lengths
-		float la = distance(m_partA->pos(), m_partB->pos());
-		float lb = distance(m_partB->pos(), m_head->pos());
-		float lg = distance(m_partA->pos(), m_goal->pos());
+		float la = distance(t->position(partA), t->position(partB));
+		float lb = distance(t->position(partB), t->position(head));
+		float lg = distance(t->position(partA), t->position(goal));
 
 		// Target out of range - lookat
 		if(lg >= la + lb) {
-			lookat(v, m_partA, m_partB, m_goal->pos());
-			lookat(v, m_partB, m_head, m_goal->pos());
+			lookat(t, partA, partB, t->position(goal));
+			lookat(t, partB, head, t->position(goal));
 		}
 		// Target too close
 		else if(lg <= fabs(la-lb)) {
-			QPointF otherWay = m_partA->pos() + (m_partA->pos() - m_goal->pos());
-			lookat(v, m_partA, m_partB, otherWay);
-			lookat(v, m_partB, m_head, m_goal->pos());
+			QPointF otherWay = t->position(partA) + (t->position(partA) - t->position(goal));
+			lookat(t, partA, partB, otherWay);
+			lookat(t, partB, head, t->position(goal));
 		}
 		// In range - ik
 		else if(lg > 0) {
-			QPointF a = m_partA->pos();
-			QPointF b = m_partB->pos() - a;
-			QPointF c = m_head->pos() - b;
-			QPointF g = m_goal->pos() - a;
+			QPointF a = t->position(partA);
+			QPointF b = t->position(partB) - a;
+			QPointF c = t->position(head) - b;
+			QPointF g = t->position(goal) - a;
 
 			float d = (lg*lg + la*la - lb*lb) / (2*lg);
 			float r = sqrt(la*la - d*d);
@@ -73,8 +81,8 @@ void IKController::apply(View* v) const {
 			// Use other goal?
 			if(b.x()*n.x() + b.y()*n.y() < 0) r0 = r1;
 
-			lookat(v, m_partA, m_partB, r0);
-			lookat(v, m_partB, m_head, m_goal->pos());
+			lookat(t, partA, partB, r0);
+			lookat(t, partB, head, t->position(goal));
 
 			// ToDo: Limits
 		}
@@ -2,14 +2,32 @@
 #define _IK_
 
 #include "part.h"
-class View;
+
+/** Anything that holds world transforms of parts that IK controllers can modify.
+ * Parts are identified by project slot */
+class IKTarget {
+	public:
+	virtual ~IKTarget() {}
+	virtual QPointF position(int slot) const = 0;					// Scene position of a part
+	virtual QPointF mapToPart(int slot, const QPointF& point) const = 0;		// Map a scene point into part coordinates
+	virtual void setAbsoluteRotation(int slot, float degrees) = 0;			// Set scene rotation of a part and move its children
+};
+
+/** Controller parts by slot. A copy that can be applied without touching the parts,
+ * so it stays valid on worker threads while parts and controllers are edited */
+struct IKChain {
+	int id;
+	int partA, partB, head, goal;	// Part slots. partB is -1 for lookat controllers
+	void apply(IKTarget* t) const;	// Apply rotations
+};
 
 class IKController {
 	public:
 	IKController(int, Part*, Part*, Part*, Part*);
 
 	/** Apply rotations from IK data */
-	void apply(View* v) const;
+	void apply(IKTarget* t) const { chain().apply(t); }
+	IKChain chain() const;	// Get the controller parts by slot
 
 	int   getID() const { return m_id; }
 	Part* getPartA() const { return m_partA; }
@@ -0,0 +1,138 @@
+#include "interpolate.h"
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define INTERPOLATE_X86
+#include <immintrin.h>
+#define TARGET(t) __attribute__((target(t)))
+#endif
+
+typedef void (*KernelFunc)(const float*, const float*, const float*, float*, int);
+
+//// //// //// //// //// //// //// //// Scalar //// //// //// //// //// //// //// ////
+
+static void valuesScalar(const float* a, const float* b, const float* t, float* out, int count) {
+	for(int i=0; i<count; i++) out[i] = a[i] + (b[i]-a[i]) * t[i];
+}
+
+static void anglesScalar(const float* a, const float* b, const float* t, float* out, int count) {
+	for(int i=0; i<count; i++) {
+		float s = a[i];
+		if(fabs(s-b[i])>180) s += (s<b[i]? 360: -360);
+		out[i] = s + (b[i]-s) * t[i];
+	}
+}
+
+#ifdef INTERPOLATE_X86
+
+//// //// //// //// //// //// //// //// SSE2 //// //// //// //// //// //// //// ////
+
+TARGET("sse2") static void valuesSSE2(const float* a, const float* b, const float* t, float* out, int count) {
+	int i = 0;
+	for(; i+4<=count; i+=4) {
+		__m128 va = _mm_loadu_ps(a+i);
+		__m128 d  = _mm_sub_ps(_mm_loadu_ps(b+i), va);
+		_mm_storeu_ps(out+i, _mm_add_ps(va, _mm_mul_ps(d, _mm_loadu_ps(t+i))));
+	}
+	valuesScalar(a+i, b+i, t+i, out+i, count-i);
+}
+
+TARGET("sse2") static void anglesSSE2(const float* a, const float* b, const float* t, float* out, int count) {
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 half = _mm_set1_ps(180);
+	const __m128 full = _mm_set1_ps(360);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	int i = 0;
+	for(; i+4<=count; i+=4) {
+		__m128 va = _mm_loadu_ps(a+i);
+		__m128 vb = _mm_loadu_ps(b+i);
+		// Add +360 if a<b, -360 otherwise, where |a-b| > 180
+		__m128 wrap = _mm_cmpgt_ps(_mm_and_ps(_mm_sub_ps(va, vb), absMask), half);
+		__m128 neg = _mm_andnot_ps(_mm_cmplt_ps(va, vb), sign);
+		va = _mm_add_ps(va, _mm_and_ps(wrap, _mm_or_ps(full, neg)));
+		__m128 d = _mm_sub_ps(vb, va);
+		_mm_storeu_ps(out+i, _mm_add_ps(va, _mm_mul_ps(d, _mm_loadu_ps(t+i))));
+	}
+	anglesScalar(a+i, b+i, t+i, out+i, count-i);
+}
+
+//// //// //// //// //// //// //// //// AVX //// //// //// //// //// //// //// ////
+
+TARGET("avx") static void valuesAVX(const float* a, const float* b, const float* t, float* out, int count) {
+	int i = 0;
+	for(; i+8<=count; i+=8) {
+		__m256 va = _mm256_loadu_ps(a+i);
+		__m256 d  = _mm256_sub_ps(_mm256_loadu_ps(b+i), va);
+		_mm256_storeu_ps(out+i, _mm256_add_ps(va, _mm256_mul_ps(d, _mm256_loadu_ps(t+i))));
+	}
+	valuesSSE2(a+i, b+i, t+i, out+i, count-i);
+}
+
+TARGET("avx") static void anglesAVX(const float* a, const float* b, const float* t, float* out, int count) {
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256 half = _mm256_set1_ps(180);
+	const __m256 full = _mm256_set1_ps(360);
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	int i = 0;
+	for(; i+8<=count; i+=8) {
+		__m256 va = _mm256_loadu_ps(a+i);
+		__m256 vb = _mm256_loadu_ps(b+i);
+		__m256 wrap = _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(va, vb), absMask), half, _CMP_GT_OQ);
+		__m256 neg = _mm256_andnot_ps(_mm256_cmp_ps(va, vb, _CMP_LT_OQ), sign);
+		va = _mm256_add_ps(va, _mm256_and_ps(wrap, _mm256_or_ps(full, neg)));
+		__m256 d = _mm256_sub_ps(vb, va);
+		_mm256_storeu_ps(out+i, _mm256_add_ps(va, _mm256_mul_ps(d, _mm256_loadu_ps(t+i))));
+	}
+	anglesSSE2(a+i, b+i, t+i, out+i, count-i);
+}
+
+#endif
+
+//// //// //// //// //// //// //// //// Selection //// //// //// //// //// //// //// ////
+
+static bool kernelSupported(InterpolateKernel k) {
+	#ifdef INTERPOLATE_X86
+	__builtin_cpu_init();
+	if(k==KERNEL_AVX) return __builtin_cpu_supports("avx");
+	if(k==KERNEL_SSE2) return __builtin_cpu_supports("sse2");
+	#endif
+	return k==KERNEL_SCALAR;
+}
+
+static InterpolateKernel bestKernel() {
+	if(kernelSupported(KERNEL_AVX)) return KERNEL_AVX;
+	if(kernelSupported(KERNEL_SSE2)) return KERNEL_SSE2;
+	return KERNEL_SCALAR;
+}
+
+static InterpolateKernel s_kernel = KERNEL_SCALAR;
+static KernelFunc s_values = valuesScalar;
+static KernelFunc s_angles = anglesScalar;
+
+void setInterpolateKernel(InterpolateKernel k) {
+	if(!kernelSupported(k)) k = KERNEL_SCALAR;
+	s_kernel = k;
+	switch(k) {
+	#ifdef INTERPOLATE_X86
+	case KERNEL_AVX:  s_values = valuesAVX;  s_angles = anglesAVX; break;
+	case KERNEL_SSE2: s_values = valuesSSE2; s_angles = anglesSSE2; break;
+	#endif
+	default: s_values = valuesScalar; s_angles = anglesScalar; break;
+	}
+}
+
+InterpolateKernel interpolateKernel() {
+	return s_kernel;
+}
+
+void interpolateValues(const float* a, const float* b, const float* t, float* out, int count) {
+	s_values(a, b, t, out, count);
+}
+
+void interpolateAngles(const float* a, const float* b, const float* t, float* out, int count) {
+	s_angles(a, b, t, out, count);
+}
+
+// Select the kernel at startup, before any worker thread can evaluate a pose
+static struct KernelInit { KernelInit() { setInterpolateKernel( bestKernel() ); } } s_init;
+
@@ -0,0 +1,17 @@
+#ifndef _INTERPOLATE_
+#define _INTERPOLATE_
+
+/** Batched interpolation kernels used for whole pose evaluation.
+ * Each channel i is interpolated as a[i] + (b[i]-a[i]) * t[i].
+ * The vector kernels give the same results as the scalar code, and the
+ * fastest one the cpu supports is selected at runtime. */
+
+void interpolateValues(const float* a, const float* b, const float* t, float* out, int count);	// Linear
+void interpolateAngles(const float* a, const float* b, const float* t, float* out, int count);	// Angles in degrees, wraps the shortest way
+
+enum InterpolateKernel { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX };
+InterpolateKernel interpolateKernel();				// Get the selected kernel
+void setInterpolateKernel(InterpolateKernel k);		// Force a kernel. Falls back to scalar if unsupported
+
+#endif
+
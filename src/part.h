@@ -6,8 +6,10 @@
 
 class Part : public QGraphicsPixmapItem {
 	public:
-	Part(int id, bool null=false) : m_id(id), m_isNull(null), m_parent(0), m_hidden(0) {}
+	Part(int id, bool null=false) : m_id(id), m_isNull(null), m_parent(0), m_hidden(0), m_slot(-1) {}
 	int getID() const { return m_id; }				// Get part unique id
+	int slot() const { return m_slot; }				// Get dense project slot index
+	void setSlot(int s) { m_slot = s; }				// Set project slot index
 	void setImage(const QPixmap& img) { setPixmap(img); }		// Set part graphic
 	void setName(const QString& s) { m_name = s; }			// Set part name
 	const QString& getName() const { return m_name; }		// Get part name
@@ -48,6 +50,7 @@ class Part : public QGraphicsPixmapItem {
 	QList<Part*> m_children;	// Child parts
 	bool         m_hidden;		// Hidden by default
 	QPointF      m_rest;		// Rest position
+	int          m_slot;		// Project slot index
 
 	QPointF absoluteRest() { return m_parent? m_parent->absoluteRest()+m_rest: m_rest; }
 };
@@ -118,6 +118,7 @@ void MovePart::move(int parentID) {
 	Part* part = getPart();
 	Part* parent = project()->getPart( parentID );
 	part->setParent( parent );
+	updateRig();
 
 	//Move in view
 	QStandardItem* root = static_cast<QStandardItemModel*>( m_list->model() )->invisibleRootItem();
@@ -154,6 +155,7 @@ void ChangeZOrder::setZ(int z, bool behind) {
 	QGraphicsItem* itm = project()->scene()->items()[z];
 	if(behind) getPart()->stackBefore( itm );
 	else itm->stackBefore( getPart() );
+	updateRig();
 	project()->scene()->invalidate( project()->scene()->sceneRect() );
 }
 
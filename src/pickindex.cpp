@@ -0,0 +1,96 @@
+#include "pickindex.h"
+#include "part.h"
+#include <QGraphicsScene>
+#include <math.h>
+
+#define MAX_GRID 64	// Maximum grid columns and rows
+
+PickIndex::PickIndex() : m_columns(0), m_rows(0), m_valid(false) {
+}
+
+bool PickIndex::Mask::test(int x, int y) const {
+	if(x<0 || y<0 || x>=width || y>=height) return false;
+	int i = y*width + x;
+	return bits[i>>5] & (1u<<(i&31));
+}
+
+PickIndex::Mask PickIndex::createMask(const QPixmap& pixmap) {
+	QImage image = pixmap.toImage().convertToFormat(QImage::Format_ARGB32);
+	Mask mask;
+	mask.width = image.width();
+	mask.height = image.height();
+	mask.bits.fill(0, (mask.width*mask.height + 31) / 32);
+	for(int y=0; y<mask.height; y++) {
+		const QRgb* line = reinterpret_cast<const QRgb*>( image.scanLine(y) );
+		for(int x=0; x<mask.width; x++) {
+			int i = y*mask.width + x;
+			if(qAlpha(line[x])) mask.bits[i>>5] |= 1u<<(i&31);
+		}
+	}
+	return mask;
+}
+
+void PickIndex::build(QGraphicsScene* scene) {
+	//Visible parts, front to back
+	QHash<qint64, Mask> masks;
+	m_entries.clear();
+	m_bounds = QRectF();
+	QList<QGraphicsItem*> items = scene->items();
+	for(int i=0; i<items.size(); i++) {
+		if(!items[i]->data(0).toInt() || !items[i]->isVisible()) continue;
+		Part* part = static_cast<Part*>(items[i]);
+		if(part->pixmap().isNull()) continue;
+		QTransform t = part->sceneTransform();
+		Entry e;
+		e.part = part;
+		e.bounds = t.mapRect( part->boundingRect() );
+		e.inverse = t.inverted();
+		e.offset = part->offset();
+		e.mask = part->pixmap().cacheKey();
+		if(!masks.contains(e.mask)) {
+			QHash<qint64, Mask>::const_iterator m = m_masks.constFind(e.mask);
+			masks[e.mask] = m!=m_masks.constEnd()? *m: createMask(part->pixmap());
+		}
+		m_entries.push_back(e);
+		m_bounds |= e.bounds;
+	}
+	m_masks = masks;
+
+	//Grid with about one cell per part
+	int size = ceil( sqrt( (double)m_entries.size() ) );
+	m_columns = m_rows = qBound(1, size, MAX_GRID);
+	m_cells.clear();
+	m_cells.resize(m_columns * m_rows);
+	for(int i=0; i<m_entries.size(); i++) {
+		const QRectF& r = m_entries[i].bounds;
+		int x1 = column(r.right()), y1 = row(r.bottom());
+		for(int y=row(r.top()); y<=y1; y++) {
+			for(int x=column(r.left()); x<=x1; x++) m_cells[y*m_columns + x].push_back(i);
+		}
+	}
+	m_valid = true;
+}
+
+int PickIndex::column(qreal x) const {
+	int c = (x - m_bounds.left()) * m_columns / m_bounds.width();
+	return qBound(0, c, m_columns-1);
+}
+
+int PickIndex::row(qreal y) const {
+	int r = (y - m_bounds.top()) * m_rows / m_bounds.height();
+	return qBound(0, r, m_rows-1);
+}
+
+Part* PickIndex::pick(const QPointF& point) const {
+	if(m_entries.empty() || !m_bounds.contains(point)) return 0;
+	const QVector<int>& cell = m_cells[ row(point.y())*m_columns + column(point.x()) ];
+	for(int i=0; i<cell.size(); i++) {
+		const Entry& e = m_entries[ cell[i] ];
+		if(!e.bounds.contains(point)) continue;
+		QPointF p = e.inverse.map(point) - e.offset;
+		QHash<qint64, Mask>::const_iterator m = m_masks.constFind(e.mask);
+		if(m!=m_masks.constEnd() && m->test( floor(p.x()), floor(p.y()) )) return e.part;
+	}
+	return 0;
+}
+
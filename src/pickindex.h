@@ -0,0 +1,49 @@
+#ifndef _PICKINDEX_
+#define _PICKINDEX_
+
+#include <QHash>
+#include <QVector>
+#include <QTransform>
+#include <QPixmap>
+
+class Part;
+class QGraphicsScene;
+
+/** Finds the part drawn at a scene point.
+ * Visible parts are bucketed by their scene bounds on a uniform grid, then hit tested
+ * against an alpha mask of their image, so transparent padding is not selectable. */
+class PickIndex {
+	public:
+	PickIndex();
+	void build(QGraphicsScene* scene);		// Index the visible parts of a scene
+	void clear() { m_valid = false; }		// Mark the index out of date. Masks are kept
+	bool isValid() const { return m_valid; }	// Has the index been built since the last change
+	Part* pick(const QPointF& point) const;		// Topmost part with an opaque pixel at a scene point
+
+	private:
+	struct Mask {
+		int width, height;
+		QVector<quint32> bits;			// One bit per pixel, set where opaque
+		bool test(int x, int y) const;
+	};
+	struct Entry {
+		Part* part;
+		QRectF bounds;				// Scene bounds
+		QTransform inverse;			// Scene to part transform
+		QPointF offset;				// Image offset in part coordinates
+		qint64 mask;				// Mask key
+	};
+	QVector<Entry> m_entries;		// Visible parts, front to back
+	QVector< QVector<int> > m_cells;	// Entries overlapping each grid cell, front to back
+	QRectF m_bounds;			// Grid area
+	int m_columns, m_rows;			// Grid size
+	QHash<qint64, Mask> m_masks;		// Alpha masks by pixmap cache key
+	bool m_valid;				// Index is up to date
+
+	static Mask createMask(const QPixmap& pixmap);	// Build the alpha mask of an image
+	int column(qreal x) const;			// Grid column of a scene x coordinate
+	int row(qreal y) const;				// Grid row of a scene y coordinate
+};
+
+#endif
+
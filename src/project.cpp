@@ -25,7 +25,8 @@ QString Project::getTitle() const {
 //// //// //// //// //// //// //// //// Part Functions //// //// //// //// //// //// //// ////
 
 Part* Project::getPart(int id) {
-	return m_parts.value( id, 0 );
+	QHash<int,int>::const_iterator slot = m_slotIndex.constFind( id );
+	return slot!=m_slotIndex.constEnd()? m_slots[ *slot ]: 0;
 }
 Part* Project::createPart(const QString& name, int id, bool null) {
 	//Assign id
@@ -44,6 +45,15 @@ void Project::addPart(Part* part, Part* parent) {
 	part->setRest(rest); //Dont change rest position
 	//Add to map
 	m_parts[ part->getID() ] = part;
+	//Assign slot - a part id keeps its slot if it is removed and added again
+	QHash<int,int>::const_iterator slot = m_slotIndex.constFind( part->getID() );
+	if(slot!=m_slotIndex.constEnd()) part->setSlot( *slot );
+	else {
+		part->setSlot( m_slots.size() );
+		m_slotIndex[ part->getID() ] = m_slots.size();
+		m_slots.push_back(0);
+	}
+	m_slots[ part->slot() ] = part;
 	//Add to scene
 	m_scene.addItem( part );
 	//Flag change
@@ -55,6 +65,7 @@ void Project::removePart(Part* part) {
 	for(int i=0; i<part->children().size(); i++) removePart( part->children()[i] );
 	m_scene.removeItem(part);
 	m_parts.remove( id );
+	m_slots[ part->slot() ] = 0;
 	if(part->getParent()) part->setParent(0);
 	//Remove from selections
 	m_selection.removeAll(part);
@@ -236,6 +247,8 @@ void Project::clear() {
 		delete *i;
 	}
 	m_parts.clear();
+	m_slots.clear();
+	m_slotIndex.clear();
 	changedPart(0);
 
 	//delete controllers
@@ -4,6 +4,8 @@
 #include <QGraphicsScene>
 #include <QString>
 #include <QMap>
+#include <QHash>
+#include <QVector>
 
 class QDomNode;
 class Animation;
@@ -32,6 +34,8 @@ class Project : public QObject {
 	QList<Part*> selectedParts();			// Get selected parts
 	Part* currentPart();					// Get the current part
 	const QList<Part*> parts();				// Get all parts in an order where parent<child
+	int   slotCount() const { return m_slots.size(); }		// Number of part slots
+	Part* slotPart(int slot) const { return m_slots[slot]; }	// Get the part in a slot (may be null)
 
 	void addAnimation(Animation* anim, int id=0);		// Add an animation
 	void removeAnimation(Animation* anim);				// Remove an animation
@@ -74,6 +78,8 @@ class Project : public QObject {
 	QList<Animation*> m_animations;			// Animation list
 	QList<IKController*> m_controllers;		// IK Controllers
 	QMap<int, Part*> m_parts;				// Parts list
+	QVector<Part*> m_slots;					// Parts by dense slot index
+	QHash<int, int> m_slotIndex;			// Part id to slot index
 	QGraphicsScene m_scene;					// The scene
 	int m_partValue;						// Value to create new part id's
 	int m_animValue;						// Value to create animation ID's
@@ -209,7 +209,7 @@ bool Project::saveProject(const QString& filename) {
 			//Add frames
 			int keyframes = 0;
 			for(int j=0; j<anim->frameCount(); j++) {
-				if(anim->isKeyframe(j, *p)) {
+				if(anim->isKeyframe(j) && anim->isKeyframe(j, *p)) {
 					Frame frame = anim->frameData(j, *p);
 					if(frame.mode) {
 						QDomElement fNode = doc.createElement("frame");
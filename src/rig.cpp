@@ -0,0 +1,139 @@
+#include "rig.h"
+#include "project.h"
+#include "part.h"
+#include <QGraphicsScene>
+#include <math.h>
+
+#define PI 3.14159265359
+
+Rig::Rig() : m_hideNulls(false) {
+}
+
+void Rig::build(Project* project, bool hideNulls) {
+	int count = project->slotCount();
+	m_hideNulls = hideNulls;
+	m_bones.clear();
+	m_bones.resize(count);
+	m_world.resize(count);
+	for(int i=0; i<count; i++) {
+		Bone& bone = m_bones[i];
+		Part* part = project->slotPart(i);
+		bone.valid = part;
+		bone.parent = -1;
+		m_world[i].angle = 0;
+		m_world[i].visible = false;
+		if(!part) continue;
+		bone.rest = part->rest();
+		bone.hidden = part->hidden();
+		bone.isNull = part->isNull();
+		if(!part->pixmap().isNull()) bone.rect = QRectF(part->offset(), part->pixmap().size());
+		if(part->getParent()) bone.parent = part->getParent()->slot();
+	}
+	for(int i=0; i<count; i++) {
+		if(m_bones[i].valid && m_bones[i].parent>=0) m_bones[ m_bones[i].parent ].children.push_back(i);
+	}
+
+	//Solve order: each root followed by its descendants
+	m_order.clear();
+	for(int i=0; i<count; i++) {
+		if(!m_bones[i].valid || m_bones[i].parent>=0) continue;
+		int start = m_order.size();
+		m_order.push_back(i);
+		for(int j=start; j<m_order.size(); j++) {
+			const QList<int>& children = m_bones[ m_order[j] ].children;
+			for(int k=0; k<children.size(); k++) m_order.push_back( children[k] );
+		}
+	}
+
+	//Draw order from the scene stacking order
+	m_draw.clear();
+	QList<QGraphicsItem*> items = project->scene()->items();
+	for(int i=items.size()-1; i>=0; i--) {
+		if(items[i]->data(0).toInt()) m_draw.push_back( static_cast<Part*>(items[i])->slot() );
+	}
+
+	m_controllers.clear();
+	foreach(IKController* c, project->controllers()) m_controllers.push_back( c->chain() );
+}
+
+void Rig::solve(const PoseBuffer& pose, const Animation* anim) {
+	for(int i=0; i<m_order.size(); i++) {
+		int s = m_order[i];
+		const Bone& bone = m_bones[s];
+		World& world = m_world[s];
+		float angle = s<pose.size()? pose.angle[s]: 0;
+		QPointF local = bone.rest + (s<pose.size()? pose.offset[s]: QPointF());
+		int visible = s<pose.size()? pose.visible[s]: -1;
+		if(bone.parent>=0) {
+			const World& parent = m_world[bone.parent];
+			float r = parent.angle * PI/180;
+			float c = cos(r), sn = sin(r);
+			world.pos = parent.pos + QPointF(local.x()*c - local.y()*sn, local.x()*sn + local.y()*c);
+			world.angle = angle + parent.angle;
+		} else {
+			world.pos = local;
+			world.angle = angle;
+		}
+		world.visible = (visible<0? !bone.hidden: visible) && !(bone.isNull && m_hideNulls);
+	}
+
+	// Controllers
+	for(int i=0; i<m_controllers.size(); i++) {
+		if(!anim || anim->getControllerState( m_controllers[i].id )) m_controllers[i].apply(this);
+	}
+}
+
+QTransform Rig::transform(int slot) const {
+	const World& world = m_world[slot];
+	QTransform t;
+	t.translate(world.pos.x(), world.pos.y());
+	t.rotate(world.angle);
+	return t;
+}
+
+QRectF Rig::bounds(int slot) const {
+	if(!m_world[slot].visible || m_bones[slot].rect.isEmpty()) return QRectF();
+	return transform(slot).mapRect( m_bones[slot].rect );
+}
+
+QRectF Rig::bounds() const {
+	QRectF box;
+	for(int i=0; i<m_order.size(); i++) {
+		QRectF r = bounds( m_order[i] );
+		if(r.isNull()) continue;
+		if(box.isNull()) box = r;
+		else box |= r;
+	}
+	return box;
+}
+
+QPointF Rig::position(int slot) const {
+	return m_world[slot].pos;
+}
+
+QPointF Rig::mapToPart(int slot, const QPointF& point) const {
+	const World& world = m_world[slot];
+	float r = world.angle * PI/180;
+	float c = cos(r), s = sin(r);
+	QPointF d = point - world.pos;
+	return QPointF(d.x()*c + d.y()*s, -d.x()*s + d.y()*c);
+}
+
+void Rig::setAbsoluteRotation(int slot, float degrees) {
+	rotateChildren(slot, m_world[slot].pos, degrees - m_world[slot].angle);
+	m_world[slot].angle = degrees;
+}
+
+void Rig::rotateChildren(int slot, const QPointF& pivot, float degrees) {
+	float r = degrees * PI/180;
+	float c = cos(r), s = sin(r);
+	const QList<int>& children = m_bones[slot].children;
+	for(int i=0; i<children.size(); i++) {
+		World& world = m_world[ children[i] ];
+		QPointF vp = world.pos - pivot;
+		world.pos = pivot + QPointF(vp.x()*c - vp.y()*s, vp.x()*s + vp.y()*c);
+		world.angle += degrees;
+		rotateChildren(children[i], pivot, degrees);
+	}
+}
+
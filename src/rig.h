@@ -0,0 +1,60 @@
+#ifndef _RIG_
+#define _RIG_
+
+#include <QTransform>
+#include "animation.h"
+#include "ik.h"
+
+class Project;
+
+/** Snapshot of the part hierarchy, indexed by part slot.
+ * Solves world transforms from a pose buffer without touching any scene item.
+ * A rig is built on the GUI thread, then copies of it can be solved on any thread. */
+class Rig : public IKTarget {
+	public:
+	Rig();
+	void build(Project* project, bool hideNulls=false);		// Snapshot the parts of a project
+	void solve(const PoseBuffer& pose, const Animation* anim=0);	// Solve world transforms, then apply controllers active in anim
+
+	int size() const { return m_bones.size(); }			// Number of slots
+	bool isVisible(int slot) const { return m_world[slot].visible; }	// Is the part in a slot drawn
+	const QPointF& pos(int slot) const { return m_world[slot].pos; }	// Scene position
+	float angle(int slot) const { return m_world[slot].angle; }	// Scene rotation in degrees
+	const QRectF& rect(int slot) const { return m_bones[slot].rect; }	// Image rect in part coordinates
+	QTransform transform(int slot) const;				// Part to scene transform
+	QRectF bounds() const;						// Scene bounds of the drawn parts
+	QRectF bounds(int slot) const;					// Scene bounds of a part. Null if not drawn
+	const QVector<int>& drawOrder() const { return m_draw; }	// Slots from back to front
+
+	// IKTarget
+	QPointF position(int slot) const;
+	QPointF mapToPart(int slot, const QPointF& point) const;
+	void setAbsoluteRotation(int slot, float degrees);
+
+	private:
+	struct Bone {
+		int parent;		// Parent slot, -1 for none
+		QPointF rest;		// Rest position
+		QRectF rect;		// Image rect in part coordinates
+		bool hidden;		// Hidden by default
+		bool isNull;		// Null marker part
+		bool valid;		// Slot has a part
+		QList<int> children;	// Child slots
+	};
+	struct World {
+		QPointF pos;		// Scene position
+		float angle;		// Scene rotation in degrees
+		bool visible;		// Drawn
+	};
+	QVector<Bone> m_bones;		// Part data by slot
+	QVector<World> m_world;		// Solved transforms by slot
+	QVector<int> m_order;		// Slots with parents before children
+	QVector<int> m_draw;		// Slots in stacking order, back to front
+	QList<IKChain> m_controllers;		// Project controllers, copied so the rig never reads parts after build
+	bool m_hideNulls;		// Null parts are never drawn
+
+	void rotateChildren(int slot, const QPointF& pivot, float degrees);	// Rotate children about a point
+};
+
+#endif
+
@@ -4,10 +4,12 @@
 #include <math.h>
 
 #include <QGraphicsRectItem>
+#include <QSet>
 
 #include "project.h"
 #include "part.h"
 #include "animation.h"
+#include "framecache.h"
 #include "ik.h"
 
 #include "editcommands.h"
@@ -16,12 +18,25 @@
 #define ZOOM 0.02 // Mouse zoom sensitivity
 
 
-View::View(QWidget* parent) : QGraphicsView(parent), m_edit(0), m_selected(0), m_animation(0), m_frame(0) {
+View::View(QWidget* parent) : QGraphicsView(parent), m_edit(0), m_selected(0), m_animation(0), m_frame(0), m_pinnedAnimation(0) {
 	m_lastOnion = 0;
 	m_frameChanged = false;
 	m_mode = 0;
 	m_autoKey = false;
 	m_hideNulls = false;
+	m_onionBefore = m_onionAfter = 0;
+	m_playback = m_showingCache = false;
+	m_outlineKey = 0;
+	m_rigDirty = true;
+	m_poseTime = 0;
+	m_fillAnimation = m_fillSnapshot = 0;
+	m_fillRevision = m_fillDone = m_fillTotal = 0;
+	m_fill = 0;
+}
+
+View::~View() {
+	// Worker threads read the fill compositor and snapshot
+	cancelCacheFill();
 }
 
 void View::createWidgets() {
@@ -41,6 +56,14 @@ void View::createWidgets() {
 	m_pivot->setZValue(4);
 	m_pivot->setFlag(QGraphicsItem::ItemIgnoresTransformations);
 
+	//Parts move every frame and picking uses its own index, so the scene keeps none
+	scene()->setItemIndexMethod(QGraphicsScene::NoIndex);
+
+	//Cached frame shown during playback
+	m_cachedFrame = new QGraphicsPixmapItem();
+	m_cachedFrame->hide();
+	scene()->addItem(m_cachedFrame);
+
 	selectItem(0);
 }
 
@@ -67,12 +90,16 @@ void View::setMode(bool edit) {
 	m_pivotLine[0]->setPen(cross);
 	m_pivotLine[1]->setPen(cross);
 	m_edit = edit;
+	m_picking.clear();
 }
 
 void View::generateCache(Animation* anim, bool override) {
-	if(anim) for(int i=0; i<anim->frameCount(); i++) {
-		if(override || !anim->hasCache(i)) cacheFrame(anim, i);
+	if(!anim) return;
+	QList<int> frames;
+	for(int i=0; i<anim->frameCount(); i++) {
+		if(override || !anim->hasCache(i)) frames.push_back(i);
 	}
+	cacheFrames(anim, frames);
 }
 
 void View::displayFrame(Animation* anim, int frame, int before, int after) {
@@ -81,21 +108,62 @@ void View::displayFrame(Animation* anim, int frame, int before, int after) {
 		cacheFrame(m_animation, m_frame);
 	}
 
-	// Setup onion skin
-	generateCache(anim, false);
-
-	//Reposition all parts
-	if(anim) updateAll(anim, frame);
+	//Reposition all parts, or show the cached image while playing
+	if(m_playback && !m_edit && anim && anim->hasCache(frame)) showCachedFrame(anim, frame);
+	else {
+		if(m_showingCache) hideCachedFrame();
+		if(anim) updateAll(anim, frame);
+	}
 	m_animation = anim;
 	m_frame = frame;
 	m_frameChanged = false;
 
-	//Display onionskin
+	//Display onionskin, missing frames are rendered in the background
 	setOnionSkin(before, after);
 }
 
+void View::setPlayback(bool on) {
+	m_playback = on;
+	if(on || !m_showingCache) return;
+	//Back to live parts
+	hideCachedFrame();
+	if(m_animation) updateAll(m_animation, m_frame);
+}
+
+void View::showCachedFrame(Animation* anim, int frame) {
+	if(!m_showingCache) {
+		//Hide parts and selection widgets, remembering what was shown
+		m_hiddenParts.clear();
+		foreach(Part* p, m_project->parts()) {
+			if(p->isVisible()) { m_hiddenParts.push_back(p); p->hide(); }
+		}
+		m_outline->hide();
+		m_parentLine->hide();
+		m_pivot->hide();
+		m_showingCache = true;
+		m_picking.clear();
+	}
+	Animation::CachedImage cached = anim->getCachedImage(frame);
+	m_cachedFrame->setPixmap( cached.image );
+	m_cachedFrame->setPos( cached.point );
+	m_cachedFrame->show();
+}
+
+void View::hideCachedFrame() {
+	m_cachedFrame->hide();
+	m_cachedFrame->setPixmap( QPixmap() );
+	foreach(Part* p, m_project->parts()) {
+		if(m_hiddenParts.contains(p)) p->show();	// Parts may have been deleted meanwhile
+	}
+	m_hiddenParts.clear();
+	m_showingCache = false;
+	m_picking.clear();
+	selectItem(m_selected);
+}
+
 void View::showNulls(bool on) {
 	m_hideNulls = !on;
+	invalidateParts();
 	foreach(Part* p, m_project->parts()) {
 		if(p->isNull()) {
 			if(m_animation) {
@@ -105,27 +173,45 @@ void View::showNulls(bool on) {
 	}
 }
 
+void View::invalidateParts() {
+	m_rigDirty = true;
+	m_picking.clear();
+	// Cached frames of every animation were drawn with the old parts
+	cancelCacheFill();
+	FrameCache::instance().removeImages();
+	m_lastOnion = 0;
+	//Drop outlines of images no part uses any more
+	QSet<qint64> images;
+	foreach(Part* p, m_project->parts()) images.insert( p->pixmap().cacheKey() );
+	for(QHash<qint64, QPainterPath>::iterator i=m_outlines.begin(); i!=m_outlines.end();) {
+		if(images.contains(i.key())) ++i;
+		else i = m_outlines.erase(i);
+	}
+}
+
 void View::updateAll(Animation* anim, int frame) {
-	//Reposition all parts
-	QList<int> parts = anim->parts();
-	for(QList<int>::Iterator i=parts.begin(); i!=parts.end(); i++) {
-		Part* part = m_project->getPart(*i);
-		if(part) {
-			Frame data = anim->frameData(frame, part);
-			updatePart(part, data);
-		}
+	QElapsedTimer timer;
+	timer.start();
+	//Evaluate all parts in one pass
+	m_pose.resize( m_project->slotCount() );
+	anim->evaluatePose(frame, m_pose, m_cursor);
+	//Solve world transforms parents first, including active controllers
+	if(m_rigDirty || m_rig.size()!=m_project->slotCount()) {
+		m_rig.build(m_project, m_hideNulls);
+		m_rigDirty = false;
 	}
-	//Update any hidden parts NOT in the list
-	QList<Part*> all = m_project->parts();
-	for(int i=0; i<all.size(); i++) {
-		if(!parts.contains(all[i]->getID())) {
-			updatePart(all[i], all[i]->hidden()? Animation::nullFrameHidden: Animation::nullFrame);
-		}
+	m_rig.solve(m_pose, anim);
+	//Reposition all parts
+	for(int i=0; i<m_rig.size(); i++) {
+		Part* part = m_project->slotPart(i);
+		if(!part) continue;
+		part->setRotation( m_rig.angle(i) );
+		part->setPos( m_rig.pos(i) );
+		part->setVisible( m_rig.isVisible(i) );
 	}
-
-
-	// Update active controllers
-	updateControllers();
+	m_picking.clear();
+	updateSelection();
+	m_poseTime = timer.nsecsElapsed();
 }
 
 void View::updateControllers() {
@@ -136,10 +222,20 @@ void View::updateControllers() {
 		}
 	}
 }
+QPointF View::position(int slot) const {
+	return m_project->slotPart(slot)->pos();
+}
+QPointF View::mapToPart(int slot, const QPointF& point) const {
+	return m_project->slotPart(slot)->mapFromScene(point);
+}
+void View::setAbsoluteRotation(int slot, float rot) {
+	setAbsoluteRotation(m_project->slotPart(slot), rot);
+}
 void View::setAbsoluteRotation(Part* p, float rot) {
-	float delta = (rot - p->rotation()) * PI/180;
-	rotateChildren(p, p->pos(), delta);
+	float delta = rot - p->rotation();
+	transformChildren(p, QTransform().translate(p->x(), p->y()).rotate(delta).translate(-p->x(), -p->y()), delta);
 	p->setRotation(rot);
+	m_picking.clear();
 	updateSelection();
 }
 
@@ -147,17 +243,17 @@ void View::setAbsoluteRotation(Part* p, float rot) {
 void View::updatePart(Part* part, const Frame& data) {
 	//Rotation
 	float ang = data.angle + (part->getParent()? part->getParent()->rotation(): 0);
-	float delta = (ang - part->rotation()) * PI/180;
-	part->setRotation( ang );
-	rotateChildren(part, part->pos(), delta);
+	float delta = ang - part->rotation();
 	//Offset
 	QPointF pos = part->rest() + data.offset;
 	if(part->getParent()) pos = part->getParent()->mapToItem(0, pos);
-	QPointF deltaPos = pos - part->pos();
+	//Children follow the part as a rigid body
+	transformChildren(part, QTransform().translate(pos.x(), pos.y()).rotate(delta).translate(-part->x(), -part->y()), delta);
+	part->setRotation( ang );
 	part->setPos(pos);
-	moveChildren(part, deltaPos);
 	// visibility
 	part->setVisible( data.visible && !(part->isNull() && m_hideNulls) );
+	m_picking.clear();
 	updateSelection();
 	m_frameChanged = true;
 }
@@ -171,7 +267,15 @@ void View::selectItem(Part* item) {
 }
 void View::updateSelection() {
 	if(m_selected) {
-		m_outline->setPath(m_selected->shape());
+		//Outline path only changes with the part image
+		qint64 key = m_selected->pixmap().cacheKey();
+		if(key!=m_outlineKey || m_selected->offset()!=m_outlineOffset) {
+			QHash<qint64, QPainterPath>::iterator path = m_outlines.find(key);
+			if(path==m_outlines.end()) path = m_outlines.insert(key, m_selected->shape().translated(-m_selected->offset()));
+			m_outline->setPath( path->translated(m_selected->offset()) );
+			m_outlineKey = key;
+			m_outlineOffset = m_selected->offset();
+		}
 		m_outline->setPos(m_selected->pos());
 		m_outline->setRotation(m_selected->rotation());
 		m_pivot->setPos( m_selected->pos() );
@@ -234,22 +338,11 @@ void View::movePart(Part* part, const QPointF& move) {
 		if(~key&2) pushCommand( new ChangeFrameData( m_animation, part, m_frame, key, key|2));
 	} 
 }
-void View::rotateChildren(Part* part, const QPointF& pivot, float angle) {
-	for(QList<Part*>::Iterator i=part->children().begin(); i!=part->children().end(); ++i) {
-		QPointF vp = (*i)->pos() - pivot;
-		float s = sin(angle);
-		float c = cos(angle);
-		//Rotated vector
-		QPointF dp(vp.x()*c+vp.y()*-s, vp.x()*s+vp.y()*c);
-		(*i)->setPos(pivot + dp);
-		(*i)->setRotation( (*i)->rotation() + angle*180/PI);
-		rotateChildren(*i, pivot, angle);
-	}
-}
-void View::moveChildren(Part* part, const QPointF& offset) {
+void View::transformChildren(Part* part, const QTransform& delta, float degrees) {
 	for(QList<Part*>::Iterator i=part->children().begin(); i!=part->children().end(); ++i) {
-		(*i)->setPos( (*i)->pos() + offset);
-		moveChildren(*i, offset);
+		(*i)->setPos( delta.map( (*i)->pos() ) );
+		(*i)->setRotation( (*i)->rotation() + degrees );
+		transformChildren(*i, delta, degrees);
 	}
 }
 
@@ -273,11 +366,8 @@ void View::moveZ(int z) { //TODO Undo for this.
 }
 
 Part* View::partAt(const QPointF& p) {
-	QList<QGraphicsItem*> items = scene()->items(p);
-	for(QList<QGraphicsItem*>::Iterator i=items.begin(); i!=items.end(); i++) {
-		if((*i)->data(0).toInt()) return static_cast<Part*>(*i);
-	}
-	return 0;
+	if(!m_picking.isValid()) m_picking.build(scene());
+	return m_picking.pick(p);
 }
 
 void View::mousePressEvent(QMouseEvent* event) {
@@ -348,8 +438,7 @@ void View::mouseReleaseEvent(QMouseEvent* event) {
 	QPointF mpos = mapToScene(event->pos());
 	if(m_moved && m_mode==3 && m_selected) { //Move pivot
 		setPivot( m_selected, mpos);
-		m_outline->setPath( m_selected->shape());
-		m_outline->setPos( m_selected->pos() );
+		updateSelection();
 	}
 	if(m_mode) m_commands->breakChain();
 	m_mode = 0;
@@ -377,46 +466,185 @@ void View::drawBackground(QPainter* painter, const QRectF& rect) {
 }
 
 void View::cacheFrame(Animation* anim, int frame) {
-	updateAll(anim, frame);
+	// Render from the animation data, the scene is left untouched
+	m_compositor.prepare(m_project, m_hideNulls);
+	Rig rig = m_compositor.solve(anim, frame);
+	QVector<Animation::CachedPart> parts = Compositor::parts(rig);
+
+	// Patch the cached image where parts changed, if they stay inside it
+	// An outdated image can be patched, as every part that moved since is redrawn
+	Animation::CachedImage cached = anim->getCachedImage(frame, true);
+	bool outdated = !anim->hasCache(frame);
+	cached.revision = -1;	// Up to date once patched
+	if(!cached.image.isNull() && cached.layout==m_compositor.layout() && cached.parts.size()==parts.size()) {
+		QRect dirty;
+		for(int i=0; i<parts.size(); i++) {
+			const Animation::CachedPart& a = parts[i];
+			const Animation::CachedPart& b = cached.parts[i];
+			if(a.region!=b.region || (!a.region.isNull() && a.transform!=b.transform)) dirty |= a.region | b.region;
+		}
+		if(dirty.isNull()) {
+			if(outdated) anim->cacheFrame(frame, cached);
+			return;
+		}
+		if(QRect(cached.point, cached.image.size()).contains(dirty)) {
+			QImage patch = m_compositor.render(rig, dirty);
+			QPainter painter(&cached.image);
+			painter.setCompositionMode(QPainter::CompositionMode_Source);
+			painter.drawImage(dirty.topLeft() - cached.point, patch);
+			painter.end();
+			cached.parts = parts;
+			anim->cacheFrame(frame, cached);
+			return;
+		}
+	}
 
-	// Hide additional graphics
-	Part* sel = m_selected;
-	selectItem(0);
-	for(int i=0; i<m_onion.size(); i++) m_onion[i]->hide();
+	// Render the whole frame
+	Compositor::Rendered r;
+	r.frame = frame;
+	r.image = m_compositor.render(rig, r.origin);
+	r.parts = parts;
+	r.layout = m_compositor.layout();
+	storeFrame(anim, r);
+}
 
-	//Generate rect
-	QRectF box;
-	QList<QGraphicsItem*> items = scene()->items();
-	for(int i=0; i<items.size(); i++) {
-		if(items[i]->isVisible() && items[i]->data(0).toInt()) {
-			if(box.isNull()) box = items[i]->sceneBoundingRect();
-			else box |= items[i]->sceneBoundingRect();
+void View::storeFrame(Animation* anim, const Compositor::Rendered& r, int revision) {
+	Animation::CachedImage cached;
+	cached.revision = revision;
+	cached.image = QPixmap::fromImage(r.image);
+	cached.point = r.origin;
+	cached.parts = r.parts;
+	cached.layout = r.layout;
+	anim->cacheFrame(r.frame, cached);
+}
+
+void View::cacheFrames(Animation* anim, const QList<int>& frames) {
+	if(frames.empty()) return;
+	// Frames are rendered on worker threads, pixmaps can only be created on this one
+	m_compositor.prepare(m_project, m_hideNulls);
+	QList<Compositor::Rendered> images = m_compositor.render(anim, frames);
+	for(int i=0; i<images.size(); i++) storeFrame(anim, images[i]);
+}
+
+void View::onionFrames(Animation* anim, int frame, int before, int after, QList<int>& frames, QList<int>& distance) const {
+	if(!anim) return;
+	int fc = anim->frameCount();
+	if(before+after > fc-1) {
+		before = after? (fc-1)/2: fc-1;
+		after = before? (fc-1)/2: fc-1;
+	}
+	bool loop = anim->loop();
+	for(int i=0; i<before+after; i++) {
+		int d = i<before? i+1: i-before+1;
+		int f = frame + (i<before? -d: d);
+		if(loop && f<0) f+=fc;
+		else if(loop && f>=fc) f-=fc;
+		if(f>=0 && f<fc) {
+			frames.push_back(f);
+			distance.push_back(d);
 		}
 	}
+}
 
-	// Create target
-	QRect rect = box.toAlignedRect(); //scene()->itemsBoundingRect().toAlignedRect();
-	QPixmap image(rect.width(), rect.height());
-	image.fill( Qt::transparent );
-	QPainter painter( &image );
-	
-	// Render scene
-	scene()->render( &painter, QRectF(), rect );
-	anim->cacheFrame(frame, &image, rect.topLeft());
+void View::pinOnionSkin(Animation* anim, int frame, int before, int after) {
+	// Keep the onion skin frames in the frame cache while they are shown
+	QList<int> frames, distance;
+	onionFrames(anim, frame, before, after, frames, distance);
+	FrameCache& cache = FrameCache::instance();
+	for(int i=0; i<frames.size(); i++) cache.pin(anim, frames[i]);
+	for(int i=0; i<m_pinned.size(); i++) cache.unpin(m_pinnedAnimation, m_pinned[i]);
+	m_pinned = frames;
+	m_pinnedAnimation = anim;
+}
+
+void View::startCacheFill(Animation* anim, int frame) {
+	if(!anim) { cancelCacheFill(); return; }
+	// Missing frames: current frame, then the onion skin, then the rest by distance
+	int fc = anim->frameCount();
+	QList<int> frames;
+	QVector<bool> queued(fc, false);
+	bool onionMissing = false;
+	if(frame>=0 && frame<fc) queued[frame] = true;
+	if(!anim->hasCache(frame)) frames.push_back(frame);
+	for(int i=0; i<m_pinned.size(); i++) {
+		if(m_pinned[i]<0 || m_pinned[i]>=fc || queued[ m_pinned[i] ]) continue;
+		queued[ m_pinned[i] ] = true;
+		if(!anim->hasCache(m_pinned[i])) { frames.push_back(m_pinned[i]); onionMissing = true; }
+	}
+	// Only the nearest frames that fit in the cache budget, or each insert evicts a frame
+	// of this animation that the next fill would render again
+	Animation::CachedImage cached = anim->getCachedImage(frame, true);
+	QSize size = cached.image.isNull()? m_rig.bounds().size().toSize(): cached.image.size();
+	qint64 bytes = (qint64)size.width() * size.height() * 4;
+	int limit = bytes>0? qMin<qint64>(FrameCache::instance().budget() / bytes, fc): fc;
+	int count = 1 + m_pinned.size();
+	for(int d=1; d<fc && count<limit; d++) {
+		int f[2] = { frame-d, frame+d };
+		for(int j=0; j<2 && count<limit; j++) {
+			if(anim->loop()) f[j] = (f[j]+fc) % fc;
+			if(f[j]<0 || f[j]>=fc || queued[ f[j] ]) continue;
+			queued[ f[j] ] = true;
+			++count;
+			if(!anim->hasCache(f[j])) frames.push_back(f[j]);
+		}
+	}
+
+	// Let a running fill continue unless the onion skin is waiting for it
+	bool current = m_fillAnimation==anim && m_fillRevision==anim->revision();
+	if(current && m_fill && m_fill->isRunning() && !onionMissing) return;
+	cancelCacheFill();
+	if(frames.empty()) return;
+
+	// Workers evaluate a copy, so keyframes can be edited while they run
+	m_fillCompositor.prepare(m_project, m_hideNulls);
+	m_fillAnimation = anim;
+	m_fillSnapshot = new Animation(*anim);
+	m_fillRevision = anim->revision();
+	m_fillDone = 0;
+	m_fillTotal = frames.size();
+	// A new watcher per fill, so events still queued from a cancelled fill never reach this one
+	m_fill = new QFutureWatcher<Compositor::Rendered>(this);
+	connect(m_fill, SIGNAL( resultReadyAt(int) ), this, SLOT( cacheFillReady(int) ));
+	connect(m_fill, SIGNAL( finished() ), this, SLOT( cacheFillFinished() ));
+	m_fill->setFuture( m_fillCompositor.renderAsync(m_fillSnapshot, frames) );
+	emit cacheProgress(m_fillDone, m_fillTotal);
+}
+
+void View::cancelCacheFill() {
+	if(!m_fillAnimation) return;
+	m_fill->disconnect(this);
+	m_fill->cancel();
+	m_fill->waitForFinished();
+	m_fill->deleteLater();
+	m_fill = 0;
+	m_fillAnimation = 0;
+	delete m_fillSnapshot;
+	m_fillSnapshot = 0;
+	emit cacheProgress(m_fillTotal, m_fillTotal);
+}
 
-	selectItem(sel);
+void View::cacheFillReady(int index) {
+	if(!m_fillAnimation || sender()!=m_fill) return;
+	// Discard frames that changed after the snapshot was taken
+	Compositor::Rendered r = m_fill->resultAt(index);
+	if(m_fillAnimation->frameRevision(r.frame) <= m_fillRevision) storeFrame(m_fillAnimation, r, m_fillRevision);
+	emit cacheProgress(++m_fillDone, m_fillTotal);
+	// Show onion skin frames as they arrive
+	if(m_fillAnimation==m_animation && m_pinned.contains(r.frame)) updateOnionSkin();
 }
 
-QPixmap View::fadeImage(const QPixmap& src, float alpha) {
-	if(src.isNull()) return src;
-	if(alpha<=0) return QPixmap();
-	QPixmap img = src.copy();
-	QPainter p;
-	p.begin(&img);
-	p.setCompositionMode( QPainter::CompositionMode_DestinationIn );
-	p.fillRect(img.rect(), QColor(0,0,0,alpha*255) );
-	p.end();
-	return img;
+void View::cacheFillFinished() {
+	if(!m_fillAnimation || sender()!=m_fill) return;
+	Animation* anim = m_fillAnimation;
+	bool stale = anim->revision() != m_fillRevision;
+	m_fill->deleteLater();
+	m_fill = 0;
+	m_fillAnimation = 0;
+	delete m_fillSnapshot;
+	m_fillSnapshot = 0;
+	emit cacheProgress(m_fillTotal, m_fillTotal);
+	// Keyframes changed while rendering: fill in the discarded frames
+	if(stale && anim==m_animation) startCacheFill(anim, m_frame);
 }
 
 void View::setOnionSkin(int before, int after) {
@@ -425,7 +653,15 @@ void View::setOnionSkin(int before, int after) {
 	if(code==m_lastOnion) return;
 	m_lastOnion = code;
 	if(!m_animation) before=after=0;
+	m_onionBefore = before;
+	m_onionAfter = after;
+	pinOnionSkin(m_animation, m_frame, before, after);
+	startCacheFill(m_animation, m_frame);
+	updateOnionSkin();
+}
 
+void View::updateOnionSkin() {
+	int before = m_onionBefore, after = m_onionAfter;
 	//Create QGraphicsPixmapItem objects
 	while(m_onion.size() < before+after) {
 		QGraphicsPixmapItem* item = new QGraphicsPixmapItem();
@@ -436,27 +672,19 @@ void View::setOnionSkin(int before, int after) {
 
 	//Create onion skin - need before + after images
 	int ix = 0; 
-	if(m_animation) {
-		int fc = m_animation->frameCount();
-		if(before+after > fc-1) {
-			before = after? (fc-1)/2: fc-1;
-			after = before? (fc-1)/2: fc-1;
-		}
-		bool loop = m_animation->loop();
-		for(int i=0; i<before+after; i++) {
-			int d = i<before? i+1: i-before+1;
-			int f = m_frame + (i<before? -d: d);
-			if(loop && f<0) f+=fc;
-			else if(loop && f>=fc) f-=fc;
-			if(f>=0 && f<fc) {
-				// Graphics item
-				float alpha = 0.6 - d*0.2;
-				QGraphicsPixmapItem* item = m_onion[ix++];
-				item->setPixmap( fadeImage( m_animation->getCachedImage(f).image, alpha ) );
-				item->setPos( m_animation->getCachedImage(f).point );
-				item->show();
-			}
-		}
+	QList<int> frames, distance;
+	onionFrames(m_animation, m_frame, before, after, frames, distance);
+	for(int i=0; i<frames.size(); i++) {
+		// Graphics item
+		float alpha = 0.6 - distance[i]*0.2;
+		if(alpha<=0) continue;
+		Animation::CachedImage cached = m_animation->getCachedImage(frames[i]);
+		if(cached.image.isNull()) continue;	// Not rendered yet
+		QGraphicsPixmapItem* item = m_onion[ix++];
+		item->setPixmap( cached.image );	// Shares the cached pixmap, faded by the item
+		item->setOpacity( alpha );
+		item->setPos( cached.point );
+		item->show();
 	}
 	//hide the rest
 	for(int i=ix; i<m_onion.size(); i++) m_onion[i]->hide();
@@ -4,33 +4,48 @@
 #include <QGraphicsView>
 #include <QMouseEvent>
 #include <QWheelEvent>
+#include <QFutureWatcher>
+#include <QPainterPath>
+#include <QElapsedTimer>
 
 #include "animation.h"
+#include "compositor.h"
+#include "pickindex.h"
+#include "ik.h"
 
 class Project;
 class Part;
 class Command;
 class CommandStack;
 
-class View : public QGraphicsView {
+class View : public QGraphicsView, public IKTarget {
 	Q_OBJECT;
 	public:
 	View(QWidget* parent=0);
+	~View();
 
 	void setProject(Project* p) { m_project=p; }		// Set the current project
 	void createWidgets();								// Create info widgets
 	void setCommandStack(CommandStack* stack);			// Set the command stack
 
 	Part* partAt(const QPointF&);						// Get a part at a point (for selection)
+	qint64 poseTime() const { return m_poseTime; }		// Nanoseconds taken by the last full pose update
+	bool isShowingCache() const { return m_showingCache; }	// Is a cached frame image shown instead of the parts
+
+	QPointF position(int slot) const;								// IKTarget: Scene position of a part item
+	QPointF mapToPart(int slot, const QPointF& point) const;		// IKTarget: Map scene point to part item
+	void setAbsoluteRotation(int slot, float degrees);				// IKTarget: Set part rotation
 
 	public slots:
 	void moveForward()  { moveZ(-1); }					// Move selected part up
 	void moveBackward() { moveZ( 1); }					// Move selected part down
 	void moveZ(int z);									// Move up or down
+	void invalidateParts();								// Parts changed: rebuild the rig, re-render cached frames and prune outlines
 	void setMode(bool edit);							// Set edit mode
 	void selectItem(Part* item);						// Set the selected item
 	void setAutoKey(bool on) { m_autoKey=on; }			// Set autokey mode
 	void showNulls(bool show);							// Show or hide all null parts
+	void setPlayback(bool on);							// Show cached frame images instead of parts while playing
 
 	void displayFrame(Animation* anim, int frame, int before=0,int after=0);//Display a frame
 	void updatePart(Part* part, const Frame& data);				//Update a part to framedata
@@ -40,6 +55,13 @@ class View : public QGraphicsView {
 
 	void setAbsoluteRotation(Part* part, float degrees);			// Set part rotation, used by controller
 
+	signals:
+	void cacheProgress(int done, int total);				// Background cache fill progress
+
+	protected slots:
+	void cacheFillReady(int index);						// A background frame has been rendered
+	void cacheFillFinished();						// Background cache fill done or cancelled
+
 	protected:
 	Project* m_project;							//project
 	bool m_edit;								//Edit rest data
@@ -49,6 +71,9 @@ class View : public QGraphicsView {
 	QGraphicsLineItem* m_parentLine;					//Parent Line widget
 	QGraphicsPathItem* m_outline;						//Selected part outline
 	Part* m_selected;							//Selected part
+	QHash<qint64, QPainterPath> m_outlines;		//Outline paths by pixmap cache key, at zero offset
+	qint64 m_outlineKey;						//Pixmap of the displayed outline
+	QPointF m_outlineOffset;					//Offset of the displayed outline
 
 	int m_mode; 	//1=move, 2=rotate			// Edit mode
 	QPointF m_moveOffset;						// Mouse offset for dragging
@@ -60,25 +85,54 @@ class View : public QGraphicsView {
 	Animation* m_animation;						// Current Animation
 	int m_frame;								// Current Frame
 	bool m_frameChanged;						//Has the current frame been modified
+	PoseBuffer m_pose;							// Evaluated frame data for all part slots
+	PoseCursor m_cursor;						// Key positions of the last evaluated frame
+	qint64 m_poseTime;							// Time taken by the last full pose update
+	Rig m_rig;									// Solved part hierarchy of the displayed frame
+	bool m_rigDirty;							// Rig must be rebuilt before solving
+	Compositor m_compositor;					// Renders cached frames without the scene
+	PickIndex m_picking;						// Finds parts under the mouse
+
+	bool m_playback;							// Animation is playing
+	bool m_showingCache;						// Parts are hidden behind the cached frame
+	QGraphicsPixmapItem* m_cachedFrame;			// Cached frame image shown during playback
+	QList<Part*> m_hiddenParts;					// Parts hidden while showing the cached frame
 
 	QList<QGraphicsPixmapItem*> m_onion;		// The onion skin
 	unsigned int m_lastOnion;					// Last state of the onion skin
+	QList<int> m_pinned;						// Onion skin frames pinned in the frame cache
+	Animation* m_pinnedAnimation;				// Animation of the pinned frames
+	int m_onionBefore, m_onionAfter;			// Onion skin frame counts
+
+	QFutureWatcher<Compositor::Rendered>* m_fill;	// Background cache fill
+	Compositor m_fillCompositor;				// Rig and images used by the background fill
+	Animation* m_fillAnimation;					// Animation being filled
+	Animation* m_fillSnapshot;					// Copy of its keyframes read by the worker threads
+	int m_fillRevision;							// Keyframe revision of the snapshot
+	int m_fillDone, m_fillTotal;				// Fill progress
 
 	void updateAll(Animation*, int frame);					//Update all parts to animation data
+	void showCachedFrame(Animation*, int frame);				//Hide the parts and show a cached frame image
+	void hideCachedFrame();							//Restore the parts hidden by showCachedFrame
 	void updateSelection();							//Update selection widgets
 	void setPivot(Part* part, const QPointF& point);			//Set the pivot to scene coordinates
 	void setRest(Part* part, const QPointF& point);				//Set the rest position to scene coordinates
 	void moveRest(Part* part, const QPointF& move);				//Move the rest position in scene coordinates
 	void rotatePart(Part* part, float angle);				//Rotate a part by angle
 	void movePart(Part* part, const QPointF& move);				//Move a part by move
-	void rotateChildren(Part* part, const QPointF& pivot, float angle);	//Rotate all child parts by angle
-	void moveChildren(Part* part, const QPointF& offset);			//Move all child objects by offset
+	void transformChildren(Part* part, const QTransform& delta, float degrees);	//Move all child parts by a rigid transform
 
 	QPointF toParent(Part* part, const QPointF&) const;			//Map point to parent part's coordinates
 
+	void onionFrames(Animation*, int frame, int before, int after, QList<int>& frames, QList<int>& distance) const;	//Get the frames shown in the onion skin
+	void pinOnionSkin(Animation*, int frame, int before, int after);	//Pin onion skin frames in the frame cache
+	void updateOnionSkin();							//Show the onion skin frames that are cached
+	void startCacheFill(Animation*, int frame);				//Render missing frames in the background, nearest first
+	void cancelCacheFill();							//Stop the background fill and discard its results
 	void drawBackground(QPainter* painter, const QRectF& rect);		//Draw background
 	void cacheFrame(Animation* anim, int frame);				//Cache animation frame for onion skinning / exporting
-	QPixmap fadeImage(const QPixmap& src, float alpha);			//Set the alpha value of an image
+	void cacheFrames(Animation* anim, const QList<int>& frames);		//Cache several frames, rendered in parallel
+	void storeFrame(Animation* anim, const Compositor::Rendered& r, int revision=-1);	//Add a rendered frame to the frame cache, rendered from a revision or the current one
 
 	void mouseMoveEvent(QMouseEvent*);					//Mouse events
 	void mousePressEvent(QMouseEvent*);
@@ -0,0 +1,112 @@
+#include "animation.h"
+#include "part.h"
+#include <QApplication>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Checks that the batched and the cursor pose evaluation give bit-identical results to
+// Animation::frameData, which interpolates one part at a time with Animation::interpolate
+
+#define FRAMES 24	// Animation length
+#define PARTS 10	// Part slots
+
+static float randomFloat(float range) {
+	return (rand() / (float)RAND_MAX * 2 - 1) * range;
+}
+
+static void key(Animation& anim, Part* part, int frame, int mode, float angle, const QPointF& offset=QPointF(), bool visible=true) {
+	Frame data;
+	data.mode = mode | anim.isKeyframe(frame, part);
+	Frame old = anim.frameData(frame, part);
+	data.angle = mode&Animation::ANGLE? angle: old.angle;
+	data.offset = mode&Animation::POS? offset: old.offset;
+	data.visible = mode&Animation::VIS? visible: old.visible;
+	anim.setKeyframe(frame, part, data);
+}
+
+// Tracks covering the special cases of interpolation
+static void createKeys(Animation& anim, Part** parts) {
+	// parts[0] has no keys
+	key(anim, parts[1], 7, Animation::ANGLE, 45);					// Single key
+	key(anim, parts[2], FRAMES-1, Animation::POS, 0, QPointF(3, -4));		// Single key on the last frame
+	key(anim, parts[3], 0, Animation::ANGLE, 170);					// First and last frame, across the 180 degree wrap
+	key(anim, parts[3], FRAMES-1, Animation::ANGLE, -170);
+	key(anim, parts[4], 2, Animation::VIS, 0, QPointF(), false);			// Visibility only
+	key(anim, parts[4], 9, Animation::VIS, 0, QPointF(), true);
+	key(anim, parts[4], 15, Animation::VIS, 0, QPointF(), false);
+	key(anim, parts[5], 4, Animation::ANGLE, -90);					// Hidden part, visibility not animated
+	key(anim, parts[5], 12, Animation::ANGLE, 90);
+	for(int s=6; s<PARTS; s++) {
+		for(int f=rand()%4; f<FRAMES; f+=1+rand()%6) {
+			int mode = 1 + rand()%7;
+			key(anim, parts[s], f, mode, randomFloat(400), QPointF(randomFloat(100), randomFloat(100)), rand()&1);
+		}
+	}
+}
+
+static bool same(float a, float b) {
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static int compare(const char* what, bool loop, int frame, int slot, const Frame& expect, const PoseBuffer& pose, Part* part) {
+	bool visible = pose.visible[slot]<0? !part->hidden(): pose.visible[slot];
+	if(same(expect.angle, pose.angle[slot]) && same(expect.offset.x(), pose.offset[slot].x())
+		&& same(expect.offset.y(), pose.offset[slot].y()) && expect.visible==visible) return 0;
+	printf("FAIL %s %s frame %d slot %d: angle %g != %g, offset %g,%g != %g,%g, visible %d != %d\n",
+		what, loop? "looped": "not looped", frame, slot,
+		pose.angle[slot], expect.angle, pose.offset[slot].x(), pose.offset[slot].y(),
+		expect.offset.x(), expect.offset.y(), visible, expect.visible);
+	return 1;
+}
+
+static int test(bool loop, Part** parts) {
+	Animation anim;
+	anim.setFrameCount(FRAMES);
+	anim.setLoop(loop);
+	createKeys(anim, parts);
+
+	// Reference values, without the bake table
+	int bakeLimit = anim.bakeLimit();
+	anim.setBakeLimit(0);
+	Frame expect[FRAMES][PARTS];
+	for(int f=0; f<FRAMES; f++) {
+		for(int s=0; s<PARTS; s++) expect[f][s] = anim.frameData(f, parts[s]);
+	}
+	anim.setBakeLimit(bakeLimit);
+
+	int failed = 0;
+	PoseBuffer pose;
+	pose.resize(PARTS);
+	for(int f=0; f<FRAMES; f++) {
+		anim.evaluatePose(f, pose);
+		for(int s=0; s<PARTS; s++) failed += compare("batch", loop, f, s, expect[f][s], pose, parts[s]);
+	}
+	// Cursor stepping forward twice, so the second pass reads the bake table, then in random order
+	PoseCursor cursor;
+	for(int pass=0; pass<3; pass++) {
+		for(int i=0; i<FRAMES; i++) {
+			int f = pass<2? i: rand()%FRAMES;
+			anim.evaluatePose(f, pose, cursor);
+			for(int s=0; s<PARTS; s++) failed += compare("cursor", loop, f, s, expect[f][s], pose, parts[s]);
+		}
+	}
+	return failed;
+}
+
+int main(int argc, char** argv) {
+	QApplication app(argc, argv, false);	// Parts hold pixmaps
+	Part* parts[PARTS];
+	for(int s=0; s<PARTS; s++) {
+		parts[s] = new Part(s+1);
+		parts[s]->setSlot(s);
+	}
+	parts[5]->setHidden(true);
+	srand(1);
+
+	int failed = test(false, parts) + test(true, parts);
+	printf("animation: %s\n", failed? "failed": "ok");
+	for(int s=0; s<PARTS; s++) delete parts[s];
+	return failed? 1: 0;
+}
+
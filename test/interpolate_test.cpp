@@ -0,0 +1,90 @@
+#include "interpolate.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Checks that every vector kernel the cpu supports gives bit-identical results to the scalar kernel
+
+#define MAX_COUNT 37	// Covers lengths that are not multiples of 4 or 8
+
+static const char* kernelName(InterpolateKernel k) {
+	switch(k) {
+	case KERNEL_SSE2: return "sse2";
+	case KERNEL_AVX:  return "avx";
+	default:          return "scalar";
+	}
+}
+
+static float randomFloat(float range) {
+	return (rand() / (float)RAND_MAX * 2 - 1) * range;
+}
+
+// Angle pairs either side of the 180 degree wrap boundary
+static void wrapAngles(float* a, float* b, int count) {
+	static const float pairs[][2] = {
+		{ 0, 180 }, { 0, -180 }, { 180, 0 }, { -180, 0 },
+		{ 170, -170 }, { -170, 170 }, { 90, -90.0001f }, { 90, -89.9999f },
+		{ 179.9999f, -0.0001f }, { -179.9999f, 0.0001f }, { 360, 0 }, { 0, 0 },
+		{ 180, -180 }, { -180, 180 }, { 540, 0 }, { 10, 190.0001f },
+	};
+	int n = sizeof(pairs) / sizeof(pairs[0]);
+	for(int i=0; i<count; i++) {
+		a[i] = pairs[i%n][0];
+		b[i] = pairs[i%n][1];
+	}
+}
+
+static int compare(InterpolateKernel k, const char* what, const float* a, const float* b, const float* t, int count, bool angles) {
+	float expect[MAX_COUNT], result[MAX_COUNT];
+	setInterpolateKernel(KERNEL_SCALAR);
+	if(angles) interpolateAngles(a, b, t, expect, count);
+	else interpolateValues(a, b, t, expect, count);
+	setInterpolateKernel(k);
+	if(angles) interpolateAngles(a, b, t, result, count);
+	else interpolateValues(a, b, t, result, count);
+	if(memcmp(expect, result, count*sizeof(float)) == 0) return 0;
+	for(int i=0; i<count; i++) {
+		if(memcmp(expect+i, result+i, sizeof(float))) {
+			printf("FAIL %s %s count %d index %d: %g != %g\n", kernelName(k), what, count, i, result[i], expect[i]);
+			break;
+		}
+	}
+	return 1;
+}
+
+int main() {
+	InterpolateKernel kernels[] = { KERNEL_SSE2, KERNEL_AVX };
+	float a[MAX_COUNT], b[MAX_COUNT], t[MAX_COUNT];
+	int failed = 0;
+	srand(1);
+
+	// The scalar kernel wraps the shortest way
+	float wa = 170, wb = -170, wt = 0.5f, wr;
+	setInterpolateKernel(KERNEL_SCALAR);
+	interpolateAngles(&wa, &wb, &wt, &wr, 1);
+	if(wr != -180) { printf("FAIL scalar wrap: %g\n", wr); ++failed; }
+
+	for(int k=0; k<2; k++) {
+		setInterpolateKernel(kernels[k]);
+		if(interpolateKernel() != kernels[k]) {
+			printf("skip %s: not supported\n", kernelName(kernels[k]));
+			continue;
+		}
+		for(int count=0; count<=MAX_COUNT; count++) {
+			for(int i=0; i<count; i++) {
+				a[i] = randomFloat(1000);
+				b[i] = randomFloat(1000);
+				t[i] = rand() / (float)RAND_MAX;
+			}
+			failed += compare(kernels[k], "values", a, b, t, count, false);
+			failed += compare(kernels[k], "angles", a, b, t, count, true);
+			wrapAngles(a, b, count);
+			failed += compare(kernels[k], "wrap", a, b, t, count, true);
+			for(int i=0; i<count; i++) t[i] = i&1? 1: 0;
+			failed += compare(kernels[k], "wrap ends", a, b, t, count, true);
+		}
+		printf("%s: %s\n", kernelName(kernels[k]), failed? "failed": "ok");
+	}
+	return failed? 1: 0;
+}
+